@@ -0,0 +1,106 @@
+#include "mpimgr.h"
+#include "mpimgr_partitioned.h"
+#include "mpimgr_pool.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+/*!
+ * fills a partition, later partitions take longer to mimic uneven producer threads
+ * @param data partition data
+ * @param count elements per partition
+ * @param partition partition index
+ */
+void produce(double *data, const int count, const int partition) {
+  for (int i = 0; i < count; ++i) {
+    double x = i;
+    for (int k = 0; k < 4 * (partition + 1); ++k) {
+      x = std::sqrt(x + k);
+    }
+    data[i] = x;
+  }
+}
+
+/*!
+ * compares one bulk send after all producers finished against partitioned sends started by each producer, ranks are
+ * paired up with even ranks producing and odd ranks consuming
+ */
+int main(int argc, char **argv) {
+  Options options;
+  options.thread_level = MPI_THREAD_MULTIPLE;
+  MPIManager mgr(argc, argv, Level::info, Ranks::zero, options);
+  if (0 != mgr.size % 2) {
+    mgr.abort("Partitioned benchmark requires an even number of ranks.");
+  }
+
+  const int partitions = argc > 1 ? std::atoi(argv[1]) : 16;
+  const int count = argc > 2 ? std::atoi(argv[2]) : 1 << 14;
+  const int iterations = argc > 3 ? std::atoi(argv[3]) : 50;
+  const bool producer = 0 == mgr.rank % 2;
+  const int peer = producer ? mgr.rank + 1 : mgr.rank - 1;
+  auto &pool = mgr.pool();
+  std::vector<double> buffer(static_cast<std::size_t>(partitions) * count);
+
+  mgr.log(Level::info,
+          fmt::format("Partitioned benchmark: {} partitions of {} doubles, {} "
+                      "iterations, partitioned MPI: {}, thread level multiple: "
+                      "{}",
+                      partitions, count, iterations,
+                      MPIMANAGER_HAVE_PARTITIONED ? "native" : "emulated",
+                      MPI_THREAD_MULTIPLE == mgr.thread_level));
+  if (MPI_THREAD_MULTIPLE != mgr.thread_level) {
+    mgr.log(Level::info,
+            "Partitioned benchmark: without MPI_THREAD_MULTIPLE only the "
+            "partitions produced by the main thread are sent early, the "
+            "others are sent in wait");
+  }
+
+  MPI_Barrier(mgr.comm);
+  mgr.timer_start(Level::debug, "bulk");
+  for (int it = 0; it < iterations; ++it) {
+    if (producer) {
+      pool.parallel_for(0, partitions, [&](const std::size_t p) {
+        produce(&buffer[p * count], count, static_cast<int>(p));
+      });
+      MPI_Send(buffer.data(), partitions * count, MPI_DOUBLE, peer, 0,
+               mgr.comm);
+    } else {
+      MPI_Recv(buffer.data(), partitions * count, MPI_DOUBLE, peer, 0,
+               mgr.comm, MPI_STATUS_IGNORE);
+    }
+  }
+  mgr.timer_stop();
+
+  MPI_Barrier(mgr.comm);
+  mgr.timer_start(Level::debug, "partitioned");
+  if (producer) {
+    PartitionedSend send(mgr, buffer.data(), partitions, count, MPI_DOUBLE,
+                         peer, 0);
+    for (int it = 0; it < iterations; ++it) {
+      send.start();
+      pool.parallel_for(0, partitions, [&](const std::size_t p) {
+        produce(&buffer[p * count], count, static_cast<int>(p));
+        send.ready(static_cast<int>(p));
+      });
+      send.wait();
+    }
+  } else {
+    PartitionedRecv recv(mgr, buffer.data(), partitions, count, MPI_DOUBLE,
+                         peer, 0);
+    for (int it = 0; it < iterations; ++it) {
+      recv.start();
+      recv.wait();
+    }
+  }
+  mgr.timer_stop();
+
+  const auto bulk = mgr.timer_stats("bulk");
+  const auto partitioned = mgr.timer_stats("partitioned");
+  double speedup = bulk->total / partitioned->total;
+  MPI_Allreduce(MPI_IN_PLACE, &speedup, 1, MPI_DOUBLE, MPI_MIN, mgr.comm);
+  mgr.log(Level::info,
+          fmt::format("Partitioned benchmark: early-bird speedup over bulk "
+                      "send (slowest pair): {:.3f}x",
+                      speedup));
+}
@@ -1,13 +1,24 @@
 #ifndef MPIMANAGER_LIBRARY_H
 #define MPIMANAGER_LIBRARY_H
 
+#include "mpimgr_sink.h"
+
 #include <fmt/core.h>
 #include <fmt/color.h>
 #include <fmt/chrono.h>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
 #include <mpi.h>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <ranges>
+#include <thread>
 #include <vector>
 
 /*!
@@ -34,6 +45,89 @@ enum class Ranks
   all,
 };
 
+/*!
+ * selection of the ranks to log on, evaluated once when the MPI environment is constructed
+ */
+class RankSelector
+{
+public:
+  /*!
+   * selects rank zero or all ranks, implicit so a Ranks value can be passed wherever a selector is expected
+   * @param ranks ranks to select
+   */
+  RankSelector(Ranks ranks);
+
+  /*!
+   * selects the rank with node rank zero on every node
+   * @return selector
+   */
+  static RankSelector node_leaders();
+
+  /*!
+   * selects an explicit set of ranks
+   * @param ranks ranks to select, ranks outside the communicator are ignored
+   * @return selector
+   */
+  static RankSelector list(std::vector<int> ranks);
+
+  /*!
+   * selects every step-th rank starting at first
+   * @param step distance between selected ranks, at least one
+   * @param first first selected rank
+   * @return selector
+   */
+  static RankSelector stride(int step, int first = 0);
+
+  /*!
+   * selects the ranks for which a predicate holds
+   * @param select predicate taking the rank
+   * @return selector
+   */
+  static RankSelector predicate(std::function<bool(int)> select);
+
+  /*!
+   * evaluates the selection for one rank
+   * @param rank rank within the communicator
+   * @param node_rank rank within the node communicator
+   * @return boolean stating if the rank is selected
+   */
+  [[nodiscard]] bool selects(int rank, int node_rank) const;
+
+private:
+  /*!
+   * constructs a selector from a predicate taking the rank and the node rank
+   * @param select predicate
+   */
+  explicit RankSelector(std::function<bool(int, int)> select);
+
+  /// predicate taking the rank and the node rank
+  std::function<bool(int, int)> select;
+};
+
+/*!
+ * operating system resource usage of the calling thread and process
+ */
+struct Usage
+{
+  /// minor page faults (serviced without I/O)
+  long minor_faults = 0;
+
+  /// major page faults (serviced with I/O)
+  long major_faults = 0;
+
+  /// voluntary context switches
+  long voluntary_switches = 0;
+
+  /// involuntary context switches
+  long involuntary_switches = 0;
+
+  /// bytes read by the process, including page cache hits
+  long long read_bytes = 0;
+
+  /// bytes written by the process, including page cache hits
+  long long write_bytes = 0;
+};
+
 /*!
  * container for managing timers
  */
@@ -47,6 +141,139 @@ struct Timer
 
   /// timer name
   std::string name;
+
+  /// resource usage at timer start
+  Usage usage;
+
+  /// energy counters in microjoules at timer start, one per RAPL domain, only populated on node leaders
+  std::vector<std::uint64_t> energy;
+};
+
+/*!
+ * statistics accumulated over all stopped timers sharing a name
+ */
+struct TimerStats
+{
+  /// number of times the timer was stopped
+  std::size_t count = 0;
+
+  /// total duration in seconds
+  double total = 0.0;
+
+  /// sum of squared durations in seconds squared
+  double total_sq = 0.0;
+
+  /// shortest duration in seconds
+  double min = std::numeric_limits<double>::infinity();
+
+  /// longest duration in seconds
+  double max = 0.0;
+
+  /// total resource usage, only populated if enabled in Options
+  Usage usage;
+
+  /// total package energy of this node in joules, only populated on node leaders if enabled in Options
+  double package_energy = 0.0;
+
+  /// total DRAM energy of this node in joules, only populated on node leaders if enabled in Options
+  double dram_energy = 0.0;
+};
+
+/*!
+ * RAPL energy counter of one package or DRAM domain read through Linux powercap
+ */
+struct EnergyDomain
+{
+  /// path of the energy_uj file
+  std::string path;
+
+  /// boolean stating if this is a DRAM domain rather than a package domain
+  bool dram = false;
+
+  /// value at which the counter wraps around in microjoules
+  std::uint64_t range = 0;
+
+  /// last raw counter value in microjoules
+  std::uint64_t last = 0;
+
+  /// counter value extended past wraparounds in microjoules
+  std::uint64_t total = 0;
+};
+
+/*!
+ * CPU frequency and temperature samples of one node taken while a timer was running
+ */
+struct FrequencyStats
+{
+  /// number of samples
+  std::size_t samples = 0;
+
+  /// sum of the node average CPU frequency over samples in MHz
+  double frequency = 0.0;
+
+  /// lowest CPU frequency of any core in MHz
+  double frequency_min = std::numeric_limits<double>::infinity();
+
+  /// highest thermal zone temperature in degrees Celsius
+  double temperature_max = 0.0;
+};
+
+struct IOHooks;
+class ThreadPool;
+
+/*!
+ * optional features of the MPI environment
+ */
+struct Options
+{
+  /// capture getrusage and /proc/self/io deltas for every timer
+  bool usage = false;
+
+  /// capture RAPL package and DRAM energy for every timer on node leaders
+  bool energy = false;
+
+  /// reduce timer, thread pool and I/O statistics across ranks and log them on rank zero when the environment is
+  /// destroyed, which costs a few collectives at exit
+  bool report = false;
+
+  /// interval in seconds at which node leaders sample CPU frequency and temperature, zero disables sampling
+  double frequency_interval = 0.0;
+
+  /// fraction of the fleet median frequency below which a node is reported as throttled
+  double frequency_ratio = 0.9;
+
+  /// number of thread pool workers, zero sizes the pool from the rank's CPU affinity mask
+  std::size_t threads = 0;
+
+  /// MPI thread support level to request
+  int thread_level = MPI_THREAD_FUNNELED;
+
+  /// buffer log records of the selected ranks in a node-shared ring written out by node leaders on log_flush, instead
+  /// of writing them in rank order behind barriers
+  bool log_aggregate = false;
+
+  /// bytes of the node-shared log ring, records that do not fit until the next flush are written directly
+  std::size_t log_ring_bytes = 1 << 20;
+
+  /// directory node leaders append their batches to as one file per node, empty forwards the batches to rank zero
+  std::string log_directory;
+
+  /// compress batches forwarded to rank zero, ignored if zlib was not found at build time
+  bool log_compress = true;
+
+  /// redirect stdout and stderr onto pipes drained into the log, lines written by other code are logged as external at
+  /// info level for stdout and warning level for stderr on every rank regardless of the rank selection
+  bool capture_output = false;
+
+  /// capacity requested for each capture pipe in bytes, capped by the system limit
+  std::size_t capture_pipe_bytes = 1 << 20;
+
+  /// file every rank logs to without barriers instead of the terminal, `{rank}` is replaced by the rank, empty logs to
+  /// the terminal, takes precedence over log_aggregate
+  std::string log_file;
+
+  /// buffering, preallocation and rotation of the per-rank log files and of the per-node files under log_directory
+  FileSinkOptions log_file_options;
 };
 
 class MPIManager
@@ -58,8 +285,9 @@ public:
    * @param argv command line argument vector
    * @param level highest level to log
    * @param ranks ranks to log on
+   * @param options optional features to enable
    */
-  MPIManager(int& argc, char** argv, Level level, Ranks ranks);
+  MPIManager(int& argc, char** argv, Level level, const RankSelector& ranks, const Options& options = {});
 
   /*!
    * destructs MPI environment
@@ -73,12 +301,19 @@ public:
   void abort(const std::string& msg);
 
   /*!
-   * logs msg to terminal at specified level and ranks
+   * logs msg to terminal at specified level and ranks, in rank order through barriers on log_comm if more than one
+   * rank is selected, must then be called on all selected ranks
    * @param level Syslog Level to log at
    * @param msg message to log
    */
   void log(Level level, const std::string& msg);
 
+  /*!
+   * writes the log records buffered in log files and, under Options::log_aggregate, in the node-shared ring with one
+   * message per node, must be called on all ranks
+   */
+  void log_flush();
+
   /*!
    * starts a timer
    * @param level timer level
@@ -91,6 +326,24 @@ public:
    */
   void timer_stop();
 
+  /*!
+   * reduces statistics of all stopped timers across ranks and logs them on rank zero, must be called on all ranks
+   */
+  void timer_report();
+
+  /*!
+   * returns the statistics this rank accumulated for a timer
+   * @param name timer name
+   * @return statistics or nothing if no timer with this name has been stopped
+   */
+  [[nodiscard]] std::optional<TimerStats> timer_stats(const std::string& name) const;
+
+  /*!
+   * returns the thread pool of this rank, starting it on first use
+   * @return thread pool
+   */
+  ThreadPool& pool();
+
   /// MPI communicator
   MPI_Comm comm;
 
@@ -100,7 +353,72 @@ public:
   /// size of MPI communicator
   int size = -1;
 
+  /// MPI thread support level provided
+  int thread_level = -1;
+
+  /// communicator of ranks sharing this node
+  MPI_Comm node_comm = MPI_COMM_NULL;
+
+  /// rank within node communicator, zero on node leaders
+  int node_rank = -1;
+
+  /// size of node communicator
+  int node_size = -1;
+
+  /// boolean stating if this rank was selected to log
+  bool log_selected = false;
+
+  /// communicator of the ranks selected to log, MPI_COMM_NULL on other ranks
+  MPI_Comm log_comm = MPI_COMM_NULL;
+
+  /// size of the log communicator, zero on ranks not selected
+  int log_size = 0;
+
 private:
+  /*!
+   * logs msg on this rank at the given level
+   * @param level Syslog Level to log at
+   * @param msg message to log
+   */
+  void log_local(Level level, const std::string& msg);
+
+  /*!
+   * appends msg to the node-shared log ring, writing it directly if the ring is full
+   * @param level Syslog Level to log at
+   * @param msg message to log
+   */
+  void log_append(Level level, const std::string& msg);
+
+  /*!
+   * writes formatted log output to the terminal, bypassing the capture pipes
+   * @param text formatted lines
+   */
+  void emit(const std::string& text);
+
+  /*!
+   * redirects stdout and stderr onto pipes and starts draining them
+   */
+  void capture_init();
+
+  /*!
+   * reads the capture pipes until both are closed, run by capture_thread
+   * @param out read end of the stdout pipe
+   * @param err read end of the stderr pipe
+   */
+  void capture_drain(int out, int err);
+
+  /*!
+   * logs a captured line, queueing it for the next flush if log records are aggregated
+   * @param level level to log at
+   * @param msg tagged line
+   */
+  void capture_line(Level level, std::string msg);
+
+  /*!
+   * restores stdout and stderr and waits for the remaining captured lines
+   */
+  void capture_stop();
+
   /*!
    * logs msg at emergency level
    * @param msg message to log
@@ -162,14 +480,147 @@ private:
    */
   [[nodiscard]] bool sufficient_rank() const;
 
+  /*!
+   * samples resource usage of the calling thread and process
+   * @return current resource usage
+   */
+  [[nodiscard]] Usage usage_now() const;
+
+  /*!
+   * gathers the union of names held by each rank, must be called on all ranks
+   * @param local names held by this rank
+   * @return sorted union of names across all ranks
+   */
+  [[nodiscard]] std::vector<std::string> union_names(const std::vector<std::string>& local) const;
+
+  /*!
+   * reduces records of the I/O profiler library across ranks and logs them on rank zero, must be called on all ranks
+   */
+  void io_report();
+
+  /*!
+   * discovers readable RAPL domains of this node
+   */
+  void energy_init();
+
+  /*!
+   * samples all RAPL domains, extending counters past wraparounds, thread safe
+   * @return counter values in microjoules, one per domain
+   */
+  std::vector<std::uint64_t> energy_now();
+
+  /*!
+   * finds the CPU frequency and temperature files on node leaders
+   */
+  void frequency_init();
+
+  /*!
+   * starts the sampler on node leaders that sample frequency or read RAPL counters, the counters being read often
+   * enough that they wrap at most once between reads
+   */
+  void sampler_init();
+
+  /*!
+   * samples CPU frequency and temperature once and attributes it to the innermost running timer
+   */
+  void frequency_sample();
+
+  /*!
+   * compares node frequencies against the fleet median and logs them on rank zero, must be called on all ranks
+   */
+  void frequency_report();
+
+  /*!
+   * reduces thread pool busy and idle times across ranks and logs them on rank zero, must be called on all ranks
+   */
+  void pool_report();
+
   /// highest level to log at
   const Level level;
 
-  /// ranks to log on
-  const Ranks ranks;
+  /// optional features
+  const Options options;
+
+  /// window of the node-shared log ring, MPI_WIN_NULL unless log records are aggregated
+  MPI_Win log_win = MPI_WIN_NULL;
+
+  /// node-shared log ring, a reservation counter followed by the records
+  char* log_ring = nullptr;
+
+  /// communicator of the node leaders, MPI_COMM_NULL unless log records are aggregated and this is a node leader
+  MPI_Comm leader_comm = MPI_COMM_NULL;
+
+  /// original stdout, -1 unless output is captured
+  int output_fd = -1;
+
+  /// original stderr, -1 unless output is captured
+  int error_fd = -1;
+
+  /// guards captured and writes to the terminal
+  std::mutex output_mutex;
+
+  /// captured lines waiting for the next log_flush to append them to the log ring
+  std::vector<std::pair<Level, std::string>> captured;
+
+  /// background thread draining the capture pipes
+  std::jthread capture_thread;
+
+  /// log file of this rank, nullptr unless Options::log_file is set
+  std::unique_ptr<FileSink> file_sink;
+
+  /// log file of this node, nullptr unless this node leader writes aggregated records under Options::log_directory
+  std::unique_ptr<FileSink> node_sink;
 
   /// stack of timers
   std::vector<Timer> timers;
+
+  /// statistics of stopped timers by name
+  std::map<std::string, TimerStats> stats;
+
+  /// file descriptor of /proc/self/io, -1 if unavailable
+  int io_fd = -1;
+
+  /// hooks of the I/O profiler library, nullptr if it is not loaded
+  const IOHooks* io_hooks = nullptr;
+
+  /// RAPL domains read by this rank, empty unless this is a node leader with readable counters
+  std::vector<EnergyDomain> energy_domains;
+
+  /// guards the counters of energy_domains
+  std::mutex energy_mutex;
+
+  /// boolean stating if any node has readable RAPL counters
+  bool energy_available = false;
+
+  /// paths of the scaling_cur_freq files of this node, empty unless this is a node leader
+  std::vector<std::string> frequency_paths;
+
+  /// paths of the thermal zone temp files of this node, empty unless this is a node leader
+  std::vector<std::string> temperature_paths;
+
+  /// boolean stating if any node is sampling CPU frequency
+  bool frequency_available = false;
+
+  /// guards sampler_region, frequency_stats and frequency_total
+  std::mutex sampler_mutex;
+
+  /// wakes the sampler for shutdown
+  std::condition_variable_any sampler_cv;
+
+  /// name of the innermost running timer, empty if none is running
+  std::string sampler_region;
+
+  /// samples by timer name
+  std::map<std::string, FrequencyStats> frequency_stats;
+
+  /// all samples of this node
+  FrequencyStats frequency_total;
+
+  /// background thread sampling frequency and reading RAPL counters, only running on node leaders
+  std::jthread sampler;
+
+  /// thread pool, nullptr until first use
+  std::unique_ptr<ThreadPool> thread_pool;
 };
 
 #endif //MPIMANAGER_LIBRARY_H
@@ -0,0 +1,247 @@
+#ifndef MPIMANAGER_ARRAY_H
+#define MPIMANAGER_ARRAY_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mpi.h>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * element type of an array file dataset
+ */
+enum class ElementType : std::uint8_t
+{
+  int8,
+  uint8,
+  int16,
+  uint16,
+  int32,
+  uint32,
+  int64,
+  uint64,
+  float32,
+  float64,
+};
+
+/*!
+ * returns the element type matching a C++ type
+ * @tparam T arithmetic type
+ * @return element type
+ */
+template <class T>
+constexpr ElementType element_type()
+{
+  static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "array elements must be numbers");
+  if constexpr (std::is_floating_point_v<T>)
+  {
+    static_assert(4 == sizeof(T) || 8 == sizeof(T), "array elements must be 32 or 64-bit floating point");
+    return 4 == sizeof(T) ? ElementType::float32 : ElementType::float64;
+  }
+  else
+  {
+    constexpr ElementType signed_types[] = {ElementType::int8, ElementType::int16, ElementType::int32,
+                                            ElementType::int64};
+    constexpr ElementType unsigned_types[] = {ElementType::uint8, ElementType::uint16, ElementType::uint32,
+                                              ElementType::uint64};
+    constexpr int index = 1 == sizeof(T) ? 0 : 2 == sizeof(T) ? 1 : 4 == sizeof(T) ? 2 : 3;
+    return std::is_signed_v<T> ? signed_types[index] : unsigned_types[index];
+  }
+}
+
+/*!
+ * returns the size of an element type
+ * @param type element type
+ * @return bytes
+ */
+std::size_t element_size(ElementType type);
+
+/*!
+ * box of an array stored contiguously in row-major order in an array file
+ */
+struct ArrayChunk
+{
+  /// index of the first element in every dimension
+  std::vector<std::uint64_t> origin;
+
+  /// number of elements in every dimension
+  std::vector<std::uint64_t> extent;
+
+  /// file offset of the first element
+  std::uint64_t offset = 0;
+};
+
+/*!
+ * dataset of an array file as described by its footer index
+ */
+struct ArrayInfo
+{
+  /// element type
+  ElementType type;
+
+  /// global number of elements in every dimension
+  std::vector<std::uint64_t> shape;
+
+  /// chunks covering the written parts of the array
+  std::vector<ArrayChunk> chunks;
+};
+
+/*!
+ * writer of a self-describing file of chunked N-D arrays
+ *
+ * The file starts with a magic number, followed by the chunk data of every dataset and a footer index describing
+ * every chunk. The footer ends with its own offset and the magic number. Every rank writes its block of a dataset
+ * collectively at an offset summed from the block sizes of the lower ranks, which one MPI_Allgather provides along
+ * with the dataset size and the number of collective write calls. Blocks are split along the first dimension into
+ * chunks so readers can fetch subsets. Rank zero collects the chunk metadata and writes the footer once on close.
+ */
+class ArrayWriter
+{
+public:
+  /*!
+   * creates or truncates a file, must be called on all ranks
+   * @param mgr MPI environment providing the communicator and timers
+   * @param path file path
+   * @param chunk_bytes target size of a chunk, a chunk holds at least one slice of the first dimension
+   */
+  ArrayWriter(MPIManager& mgr, const std::string& path, std::size_t chunk_bytes = std::size_t{4} << 20);
+
+  /*!
+   * closes the file if close was not called, must be called on all ranks
+   */
+  ~ArrayWriter();
+
+  ArrayWriter(const ArrayWriter&) = delete;
+  ArrayWriter& operator=(const ArrayWriter&) = delete;
+
+  /*!
+   * writes the block of a dataset held by this rank, must be called on all ranks for every dataset
+   * @tparam T element type
+   * @param name dataset name, unique within the file
+   * @param shape global number of elements in every dimension
+   * @param origin index of the first element of the block in every dimension
+   * @param extent number of elements of the block in every dimension, zero in any dimension for no block
+   * @param data block in row-major order
+   */
+  template <class T>
+  void write(const std::string& name, const std::vector<std::uint64_t>& shape,
+             const std::vector<std::uint64_t>& origin, const std::vector<std::uint64_t>& extent,
+             std::span<const T> data)
+  {
+    write_bytes(name, element_type<T>(), shape, origin, extent, data.data(), data.size_bytes());
+  }
+
+  /*!
+   * writes the footer index and closes the file, must be called on all ranks
+   */
+  void close();
+
+private:
+  /*!
+   * writes the block of a dataset held by this rank
+   * @param name dataset name
+   * @param type element type
+   * @param shape global number of elements in every dimension
+   * @param origin index of the first element of the block in every dimension
+   * @param extent number of elements of the block in every dimension
+   * @param data block in row-major order
+   * @param bytes size of data
+   */
+  void write_bytes(const std::string& name, ElementType type, const std::vector<std::uint64_t>& shape,
+                   const std::vector<std::uint64_t>& origin, const std::vector<std::uint64_t>& extent,
+                   const void* data, std::size_t bytes);
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// file path
+  std::string path;
+
+  /// target size of a chunk
+  std::size_t chunk_bytes;
+
+  /// MPI file handle, MPI_FILE_NULL once closed
+  MPI_File fh = MPI_FILE_NULL;
+
+  /// offset of the end of the data written so far
+  std::uint64_t end;
+
+  /// index of the datasets written so far, only kept on rank zero
+  std::map<std::string, ArrayInfo> index;
+};
+
+/*!
+ * reader of files written by ArrayWriter, with any number of ranks
+ */
+class ArrayReader
+{
+public:
+  /*!
+   * opens a file and reads its footer index on rank zero, which shares it with every rank, must be called on all
+   * ranks
+   * @param mgr MPI environment providing the communicator
+   * @param path file path
+   */
+  ArrayReader(MPIManager& mgr, const std::string& path);
+
+  /*!
+   * closes the file, must be called on all ranks
+   */
+  ~ArrayReader();
+
+  ArrayReader(const ArrayReader&) = delete;
+  ArrayReader& operator=(const ArrayReader&) = delete;
+
+  /*!
+   * returns the datasets of the file
+   * @return index by dataset name
+   */
+  [[nodiscard]] const std::map<std::string, ArrayInfo>& datasets() const;
+
+  /*!
+   * reads a hyperslab of a dataset, reading only the chunks intersecting it, independent of other ranks
+   * @tparam T element type, must match the stored type
+   * @param name dataset name
+   * @param origin index of the first element of the hyperslab in every dimension
+   * @param extent number of elements of the hyperslab in every dimension
+   * @param out hyperslab in row-major order, elements not covered by any chunk are left untouched
+   */
+  template <class T>
+  void read(const std::string& name, const std::vector<std::uint64_t>& origin,
+            const std::vector<std::uint64_t>& extent, std::span<T> out)
+  {
+    read_bytes(name, element_type<T>(), origin, extent, out.data(), out.size_bytes());
+  }
+
+private:
+  /*!
+   * reads a hyperslab of a dataset
+   * @param name dataset name
+   * @param type requested element type
+   * @param origin index of the first element of the hyperslab in every dimension
+   * @param extent number of elements of the hyperslab in every dimension
+   * @param out hyperslab in row-major order
+   * @param bytes size of out
+   */
+  void read_bytes(const std::string& name, ElementType type, const std::vector<std::uint64_t>& origin,
+                  const std::vector<std::uint64_t>& extent, void* out, std::size_t bytes);
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// file path
+  std::string path;
+
+  /// MPI file handle
+  MPI_File fh = MPI_FILE_NULL;
+
+  /// index of the datasets
+  std::map<std::string, ArrayInfo> index;
+};
+
+#endif //MPIMANAGER_ARRAY_H
@@ -0,0 +1,118 @@
+#ifndef MPIMANAGER_CHECKPOINT_H
+#define MPIMANAGER_CHECKPOINT_H
+
+#include "mpimgr.h"
+
+#include <chrono>
+#include <functional>
+#include <mpi.h>
+#include <string>
+
+/*!
+ * configuration of a CheckpointScheduler
+ */
+struct CheckpointOptions
+{
+  /// mean time between failures in seconds, zero to use MPIMANAGER_MTBF, the history or one day in that order
+  double mtbf = 0.0;
+
+  /// checkpoint cost in seconds assumed until the first checkpoint is measured
+  double cost = 60.0;
+
+  /// file recording the start, checkpoints, deadline stop and clean end of every run, used to observe the MTBF, empty
+  /// to disable
+  std::string history;
+
+  /// timer name of checkpoint writes
+  std::string timer = "Checkpoint";
+};
+
+/*!
+ * schedules checkpoints at the interval minimizing expected lost work, following Young and Daly
+ *
+ * For checkpoint cost C and mean time between failures M the interval is sqrt(2 C M) with Daly's higher order
+ * correction, or M itself if C >= 2 M. The cost is the slowest rank's mean checkpoint duration measured by an
+ * MPIManager timer. Rank zero decides at every step boundary and shares the decision with a non-blocking broadcast
+ * that completes by the next step boundary, so steps never synchronize and a due checkpoint is taken one step late.
+ */
+class CheckpointScheduler
+{
+public:
+  /*!
+   * constructs a scheduler, records the run start in the history and logs the initial interval, must be called on
+   * all ranks
+   * @param mgr MPI environment providing the communicator, timers and logging
+   * @param options configuration
+   */
+  CheckpointScheduler(MPIManager& mgr, CheckpointOptions options = {});
+
+  /*!
+   * completes a decision in flight and records the clean end of the run in the history
+   */
+  ~CheckpointScheduler();
+
+  CheckpointScheduler(const CheckpointScheduler&) = delete;
+  CheckpointScheduler& operator=(const CheckpointScheduler&) = delete;
+
+  /*!
+   * returns the decision rank zero made at the previous step boundary and starts the next decision, must be called
+   * on all ranks at every step boundary
+   * @return boolean stating if a checkpoint should be written now, identical on all ranks
+   */
+  bool should_checkpoint();
+
+  /*!
+   * writes a checkpoint under the checkpoint timer, records it in the history as the last time the run is known to be
+   * alive and updates the interval from its measured cost, must be called on all ranks
+   * @param write writes the checkpoint
+   */
+  void checkpoint(const std::function<void()>& write);
+
+  /*!
+   * records in the history that the run stops for its walltime limit, so it does not count as a failure even if the
+   * batch system kills it before the clean end is recorded, call once DeadlineManager::should_stop returned true and
+   * before the final checkpoint, only rank zero writes
+   */
+  void deadline_stop();
+
+  /*!
+   * returns the current checkpoint interval
+   * @return seconds
+   */
+  [[nodiscard]] double interval() const;
+
+private:
+  /*!
+   * recomputes the interval from the current cost and MTBF
+   */
+  void update();
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// configuration
+  CheckpointOptions options;
+
+  /// mean time between failures in seconds
+  double mtbf;
+
+  /// description of where the MTBF came from
+  std::string mtbf_source;
+
+  /// slowest rank's mean checkpoint cost in seconds
+  double cost;
+
+  /// checkpoint interval in seconds
+  double period = 0.0;
+
+  /// end of the last checkpoint or the start of the run, on rank zero
+  std::chrono::steady_clock::time_point last;
+
+  /// decision being broadcast
+  int decision = 0;
+
+  /// broadcast of the decision, MPI_REQUEST_NULL before the first step boundary
+  MPI_Request request = MPI_REQUEST_NULL;
+};
+
+#endif //MPIMANAGER_CHECKPOINT_H
@@ -0,0 +1,117 @@
+#ifndef MPIMANAGER_COLLECTIVE_H
+#define MPIMANAGER_COLLECTIVE_H
+
+#include "mpimgr.h"
+
+#include <functional>
+#include <mpi.h>
+
+/// MPI 4 persistent collectives are available, otherwise they are emulated with cached non-blocking collectives
+#define MPIMANAGER_HAVE_PERSISTENT_COLLECTIVES (MPI_VERSION >= 4)
+
+/*!
+ * collective operation set up once and then started repeatedly on the same buffers, must be constructed, started and
+ * waited on by all ranks of the communicator in the same order
+ */
+class PersistentCollective
+{
+public:
+  /*!
+   * frees the persistent request, completing an active operation first
+   */
+  ~PersistentCollective();
+
+  PersistentCollective(const PersistentCollective&) = delete;
+  PersistentCollective& operator=(const PersistentCollective&) = delete;
+
+  /*!
+   * starts the operation
+   */
+  void start();
+
+  /*!
+   * completes the operation
+   */
+  void wait();
+
+  /*!
+   * checks for completion of the operation without blocking
+   * @return boolean stating if the operation has completed
+   */
+  bool test();
+
+protected:
+  /*!
+   * constructs an operation
+   * @param init creates a persistent request, used with MPI 4
+   * @param launch starts a non-blocking collective, used without MPI 4
+   */
+  PersistentCollective(const std::function<void(MPI_Request*)>& init, std::function<void(MPI_Request*)> launch);
+
+private:
+  /// request of the persistent or current non-blocking operation
+  MPI_Request request = MPI_REQUEST_NULL;
+
+  /// boolean stating if the operation is running
+  bool active = false;
+
+  /// starts a non-blocking collective on the cached arguments
+  std::function<void(MPI_Request*)> launch;
+};
+
+/*!
+ * persistent allreduce
+ */
+class PersistentAllreduce : public PersistentCollective
+{
+public:
+  /*!
+   * sets up an allreduce
+   * @param mgr MPI environment providing the communicator
+   * @param sendbuf send buffer or MPI_IN_PLACE
+   * @param recvbuf receive buffer
+   * @param count number of elements
+   * @param type element datatype
+   * @param op reduction operation
+   */
+  PersistentAllreduce(MPIManager& mgr, const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op);
+};
+
+/*!
+ * persistent reduce
+ */
+class PersistentReduce : public PersistentCollective
+{
+public:
+  /*!
+   * sets up a reduce
+   * @param mgr MPI environment providing the communicator
+   * @param sendbuf send buffer or MPI_IN_PLACE on root
+   * @param recvbuf receive buffer, significant on root only
+   * @param count number of elements
+   * @param type element datatype
+   * @param op reduction operation
+   * @param root root rank
+   */
+  PersistentReduce(MPIManager& mgr, const void* sendbuf, void* recvbuf, int count, MPI_Datatype type, MPI_Op op,
+                   int root);
+};
+
+/*!
+ * persistent broadcast
+ */
+class PersistentBcast : public PersistentCollective
+{
+public:
+  /*!
+   * sets up a broadcast
+   * @param mgr MPI environment providing the communicator
+   * @param buf buffer, sent on root and received elsewhere
+   * @param count number of elements
+   * @param type element datatype
+   * @param root root rank
+   */
+  PersistentBcast(MPIManager& mgr, void* buf, int count, MPI_Datatype type, int root);
+};
+
+#endif //MPIMANAGER_COLLECTIVE_H
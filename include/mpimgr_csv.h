@@ -0,0 +1,100 @@
+#ifndef MPIMANAGER_CSV_H
+#define MPIMANAGER_CSV_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * value type of a CSV column
+ */
+enum class ColumnType
+{
+  /// 64-bit signed integers, empty fields read as zero
+  integer,
+
+  /// doubles, empty fields read as NaN
+  real,
+
+  /// strings
+  text,
+};
+
+/*!
+ * one column of the rows read by a rank, only the vector matching its type is filled
+ */
+struct CsvColumn
+{
+  /// name from the header line, or the column index if the file has no header
+  std::string name;
+
+  /// value type
+  ColumnType type;
+
+  /// values of an integer column
+  std::vector<std::int64_t> integers;
+
+  /// values of a real column
+  std::vector<double> reals;
+
+  /// values of a text column
+  std::vector<std::string> texts;
+};
+
+/*!
+ * rows of a CSV file read by one rank, stored by column
+ */
+struct CsvTable
+{
+  /// columns
+  std::vector<CsvColumn> columns;
+
+  /// number of rows read by this rank
+  std::uint64_t rows = 0;
+
+  /// global index of the first row read by this rank
+  std::uint64_t first_row = 0;
+};
+
+/*!
+ * parallel reader of delimiter-separated text files
+ *
+ * Every rank reads one byte range of the file with collective MPI-IO, hands the partial record at the start of its
+ * range to its left neighbour in a single exchange and parses the whole records it owns, scanning for delimiters with
+ * SIMD. Fields must not contain quoted delimiters or newlines, and every record must be shorter than the byte range of
+ * a rank.
+ */
+class CsvReader
+{
+public:
+  /*!
+   * constructs a reader
+   * @param mgr MPI environment providing the communicator and timers
+   * @param delimiter field delimiter
+   * @param header boolean stating if the first line holds column names
+   */
+  explicit CsvReader(MPIManager& mgr, char delimiter = ',', bool header = true);
+
+  /*!
+   * reads a file, must be called on all ranks, logs the rows per second achieved
+   * @param path file path
+   * @param types column types, columns beyond the given types are read as text
+   * @return rows read by this rank in file order, ranks holding consecutive parts of the file
+   */
+  CsvTable read(const std::string& path, const std::vector<ColumnType>& types);
+
+private:
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// field delimiter
+  char delimiter;
+
+  /// boolean stating if the first line holds column names
+  bool header;
+};
+
+#endif //MPIMANAGER_CSV_H
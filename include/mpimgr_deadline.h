@@ -0,0 +1,102 @@
+#ifndef MPIMANAGER_DEADLINE_H
+#define MPIMANAGER_DEADLINE_H
+
+#include "mpimgr.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <string>
+
+/*!
+ * configuration of a DeadlineManager
+ */
+struct DeadlineOptions
+{
+  /// seconds until the deadline from construction, zero to read MPIMANAGER_DEADLINE or MPIMANAGER_WALLTIME
+  double remaining = 0.0;
+
+  /// timer of the steps, the time between should_stop calls is used if it has no statistics
+  std::string step_timer = "Step";
+
+  /// timer of checkpoint writes
+  std::string checkpoint_timer = "Checkpoint";
+
+  /// checkpoint duration in seconds assumed until one is measured
+  double checkpoint_cost = 60.0;
+
+  /// number of standard deviations added to the mean step and checkpoint durations
+  double safety = 3.0;
+
+  /// seconds reserved for finalization after the final checkpoint
+  double margin = 30.0;
+};
+
+/*!
+ * stops a run before its walltime limit with time left for a final checkpoint
+ *
+ * The deadline is given as an option or read on rank zero from MPIMANAGER_DEADLINE, an absolute Unix time in seconds,
+ * or MPIMANAGER_WALLTIME, the walltime in seconds or [[HH:]MM:]SS counted from construction. At every step boundary
+ * the next step and the final checkpoint are predicted as their mean plus a safety multiple of the standard deviation
+ * from timer statistics, and the run stops once they no longer fit before the deadline. The prediction of the slowest
+ * rank decides, so all ranks stop at the same step.
+ */
+class DeadlineManager
+{
+public:
+  /*!
+   * resolves the deadline on rank zero and shares it with every rank, must be called on all ranks
+   * @param mgr MPI environment providing the communicator, timers and logging
+   * @param options configuration
+   */
+  DeadlineManager(MPIManager& mgr, DeadlineOptions options = {});
+
+  /*!
+   * decides if the run must stop before starting another step, must be called on all ranks at every step boundary
+   * @return boolean stating if the run must write its final checkpoint and exit, identical on all ranks
+   */
+  bool should_stop();
+
+  /*!
+   * writes the final checkpoint under the checkpoint timer and logs the time left, must be called on all ranks once
+   * should_stop returned true, the caller then leaves its step loop so MPIManager finalizes cleanly
+   * @param write writes the checkpoint
+   */
+  void finish(const std::function<void()>& write);
+
+  /*!
+   * returns the time left until the deadline
+   * @return seconds, infinite without a deadline
+   */
+  [[nodiscard]] double remaining() const;
+
+private:
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// configuration
+  DeadlineOptions options;
+
+  /// boolean stating if a deadline is known
+  bool enabled = false;
+
+  /// deadline on the local steady clock
+  std::chrono::steady_clock::time_point deadline;
+
+  /// previous should_stop call
+  std::chrono::steady_clock::time_point previous;
+
+  /// boolean stating if should_stop was called before
+  bool started = false;
+
+  /// number of steps measured between should_stop calls
+  std::size_t steps = 0;
+
+  /// sum of the measured step durations in seconds
+  double steps_total = 0.0;
+
+  /// sum of the squared measured step durations in seconds squared
+  double steps_total_sq = 0.0;
+};
+
+#endif //MPIMANAGER_DEADLINE_H
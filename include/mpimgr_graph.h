@@ -0,0 +1,181 @@
+#ifndef MPIMANAGER_GRAPH_H
+#define MPIMANAGER_GRAPH_H
+
+#include "mpimgr.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+class ThreadPool;
+
+/// identifier of a task within a TaskGraph
+using TaskId = std::size_t;
+
+/*!
+ * kind of a TaskGraph task
+ */
+enum class TaskKind
+{
+  /// local computation run on the thread pool
+  compute,
+
+  /// non-blocking MPI operation started and polled by the thread calling run
+  communicate,
+};
+
+/*!
+ * directed acyclic graph of compute and communication tasks executed with maximal overlap
+ */
+class TaskGraph
+{
+public:
+  /*!
+   * constructs an empty graph
+   * @param mgr MPI environment providing the communicator, thread pool and timers
+   * @param name timer name of each run
+   */
+  TaskGraph(MPIManager& mgr, std::string name);
+
+  /*!
+   * adds a local compute task
+   * @param name task name used in traces
+   * @param fn work to run on the thread pool
+   * @param deps tasks that must finish first
+   * @return task identifier
+   */
+  TaskId compute(const std::string& name, std::function<void()> fn, const std::vector<TaskId>& deps = {});
+
+  /*!
+   * adds a communication task
+   * @param name task name used in traces
+   * @param start starts non-blocking MPI operations on the given communicator and returns their requests
+   * @param deps tasks that must finish first
+   * @return task identifier
+   */
+  TaskId communicate(const std::string& name, std::function<std::vector<MPI_Request>(MPI_Comm)> start,
+                     const std::vector<TaskId>& deps = {});
+
+  /*!
+   * executes every task once, ready compute tasks run on the thread pool while the calling thread starts
+   * communication tasks and polls them with MPI_Testsome
+   * @param level timer level of the run
+   */
+  void run(Level level = Level::debug);
+
+  /*!
+   * writes the schedule of the last run of every rank as a Chrome trace to a file, must be called on all ranks
+   * @param path output path written by rank zero
+   */
+  void trace(const std::string& path) const;
+
+private:
+  /*!
+   * task and the record of its last execution
+   */
+  struct Node
+  {
+    /// task name
+    std::string name;
+
+    /// task kind
+    TaskKind kind = TaskKind::compute;
+
+    /// compute work
+    std::function<void()> fn{};
+
+    /// communication start
+    std::function<std::vector<MPI_Request>(MPI_Comm)> start{};
+
+    /// number of dependencies
+    std::size_t deps = 0;
+
+    /// tasks depending on this one
+    std::vector<TaskId> successors{};
+
+    /// start of the last execution in nanoseconds since the run started
+    std::int64_t begin_ns = 0;
+
+    /// end of the last execution in nanoseconds since the run started
+    std::int64_t end_ns = 0;
+
+    /// thread of the last execution
+    std::thread::id thread{};
+  };
+
+  /*!
+   * adds a task
+   * @param node task
+   * @param deps tasks that must finish first
+   * @return task identifier
+   */
+  TaskId add(Node node, const std::vector<TaskId>& deps);
+
+  /*!
+   * runs a compute task and releases its successors, called on pool threads
+   * @param id task identifier
+   */
+  void execute(TaskId id);
+
+  /*!
+   * releases successors of a finished task
+   * @param id task identifier
+   */
+  void release(TaskId id);
+
+  /*!
+   * queues a task whose dependencies have finished
+   * @param id task identifier
+   */
+  void ready(TaskId id);
+
+  /*!
+   * returns the time since the run started
+   * @return nanoseconds
+   */
+  [[nodiscard]] std::int64_t elapsed() const;
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// timer name of each run
+  std::string name;
+
+  /// tasks
+  std::vector<Node> nodes;
+
+  /// unfinished dependencies by task during a run
+  std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+
+  /// number of finished tasks during a run
+  std::atomic<std::size_t> finished{0};
+
+  /// guards ready_comms
+  std::mutex ready_mutex;
+
+  /// communication tasks whose dependencies have finished
+  std::vector<TaskId> ready_comms;
+
+  /// thread pool running compute tasks during a run
+  ThreadPool* pool = nullptr;
+
+  /// group of compute tasks spawned during a run
+  TaskGroup* group = nullptr;
+
+  /// start of the current run
+  std::chrono::steady_clock::time_point origin;
+
+  /// thread calling run
+  std::thread::id owner;
+};
+
+#endif //MPIMANAGER_GRAPH_H
@@ -0,0 +1,118 @@
+#ifndef MPIMANAGER_HISTOGRAM_H
+#define MPIMANAGER_HISTOGRAM_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*!
+ * distributed histogram of equal width bins over [lower, upper) with underflow and overflow counts
+ *
+ * Values are binned locally and only the count arrays are merged, so a global histogram costs one reduction
+ * regardless of the number of values.
+ */
+class Histogram
+{
+public:
+  /*!
+   * constructs an empty histogram over a fixed range
+   * @param mgr MPI environment providing the communicator and thread pool
+   * @param bins number of bins
+   * @param lower lower edge of the first bin
+   * @param upper upper edge of the last bin
+   */
+  Histogram(MPIManager& mgr, std::size_t bins, double lower, double upper);
+
+  /*!
+   * agrees on the global range of values across ranks with a single min/max reduction and clears all counts, must
+   * be called on all ranks
+   * @param values local values the histogram will be filled with
+   */
+  void fit(std::span<const double> values);
+
+  /*!
+   * bins values on the calling thread, NaN counts as underflow
+   * @param values values to bin
+   */
+  void add(std::span<const double> values);
+
+  /*!
+   * bins values across the thread pool, every thread fills a private sub-histogram and the sub-histograms are summed
+   * afterwards so no atomics are needed
+   * @param values values to bin
+   */
+  void add_parallel(std::span<const double> values);
+
+  /*!
+   * sums the counts of all ranks with a single MPI_Allreduce, must be called on all ranks
+   */
+  void reduce();
+
+  /*!
+   * sums the counts of several histograms of all ranks with a single MPI_Allreduce, must be called on all ranks with
+   * the same histograms in the same order
+   * @param histograms histograms sharing one MPI environment
+   */
+  static void reduce(std::span<Histogram> histograms);
+
+  /*!
+   * clears all counts
+   */
+  void clear();
+
+  /*!
+   * returns the counts of the bins
+   * @return counts of bins 0 through bins - 1
+   */
+  [[nodiscard]] std::span<const std::uint64_t> counts() const;
+
+  /*!
+   * returns the number of values below lower, including NaN
+   * @return count
+   */
+  [[nodiscard]] std::uint64_t underflow() const;
+
+  /*!
+   * returns the number of values at or above upper
+   * @return count
+   */
+  [[nodiscard]] std::uint64_t overflow() const;
+
+  /*!
+   * returns the lower edge of a bin
+   * @param bin bin index, bins gives the upper edge of the last bin
+   * @return edge
+   */
+  [[nodiscard]] double edge(std::size_t bin) const;
+
+private:
+  /*!
+   * bins values into a count array laid out like tally
+   * @param values values to bin
+   * @param counts underflow, bins and overflow counts to increment
+   */
+  void bin(std::span<const double> values, std::span<std::uint64_t> counts) const;
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// number of bins
+  std::size_t bins;
+
+  /// lower edge of the first bin
+  double lower;
+
+  /// upper edge of the last bin
+  double upper;
+
+  /// bins per unit value
+  double scale;
+
+  /// underflow count, bin counts and overflow count
+  std::vector<std::uint64_t> tally;
+};
+
+#endif //MPIMANAGER_HISTOGRAM_H
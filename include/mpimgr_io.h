@@ -0,0 +1,96 @@
+#ifndef MPIMANAGER_IO_H
+#define MPIMANAGER_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// number of access size histogram bins, bin i holds sizes below 256 * 4^i bytes and the last bin holds the rest
+constexpr std::size_t io_histogram_bins = 10;
+
+/// accesses below this many bytes count as small
+constexpr std::size_t io_small_access = 4096;
+
+/// number of operations above which a small I/O or metadata pattern is flagged
+constexpr std::uint64_t io_storm_ops = 1000;
+
+/*!
+ * POSIX I/O counters of one file within one timer region
+ */
+struct IOCounters
+{
+  /// calls to open
+  std::uint64_t opens = 0;
+
+  /// calls to read and pread
+  std::uint64_t reads = 0;
+
+  /// calls to write and pwrite
+  std::uint64_t writes = 0;
+
+  /// calls to fsync and fdatasync
+  std::uint64_t syncs = 0;
+
+  /// calls to stat
+  std::uint64_t stats = 0;
+
+  /// bytes read
+  std::uint64_t read_bytes = 0;
+
+  /// bytes written
+  std::uint64_t write_bytes = 0;
+
+  /// accesses starting where the previous access of the file descriptor ended
+  std::uint64_t sequential = 0;
+
+  /// all other accesses
+  std::uint64_t random = 0;
+
+  /// seconds spent in read and pread
+  double read_time = 0.0;
+
+  /// seconds spent in write and pwrite
+  double write_time = 0.0;
+
+  /// seconds spent in open, stat, fsync and fdatasync
+  double meta_time = 0.0;
+
+  /// access size histogram, see io_histogram_bins
+  std::uint64_t histogram[io_histogram_bins] = {};
+};
+
+/*!
+ * I/O counters attributed to a timer region and file
+ */
+struct IORecord
+{
+  /// name of the innermost running timer, empty if none was running
+  std::string region;
+
+  /// path the file was opened or stated with
+  std::string path;
+
+  /// counters
+  IOCounters counters;
+};
+
+/*!
+ * entry points of the I/O profiler library, looked up at runtime so MPIManager does not depend on it
+ */
+struct IOHooks
+{
+  /// enters a timer region
+  void (*region_push)(const char* name);
+
+  /// leaves the innermost timer region
+  void (*region_pop)();
+
+  /// copies all records collected so far
+  void (*snapshot)(std::vector<IORecord>& records);
+};
+
+/// hooks exported by the I/O profiler library under this name
+extern "C" const IOHooks mpimgr_io_hooks;
+
+#endif //MPIMANAGER_IO_H
@@ -0,0 +1,142 @@
+#ifndef MPIMANAGER_PARTITIONED_H
+#define MPIMANAGER_PARTITIONED_H
+
+#include "mpimgr.h"
+
+#include <atomic>
+#include <memory>
+#include <mpi.h>
+#include <thread>
+#include <vector>
+
+/// MPI 4 partitioned point-to-point communication is available, otherwise it is emulated with persistent requests
+#define MPIMANAGER_HAVE_PARTITIONED (MPI_VERSION >= 4)
+
+/*!
+ * partitioned send, each partition of the buffer is sent as soon as its producer marks it ready
+ *
+ * Without MPI 4 every partition is an individual persistent send tagged tag + partition, so the tags tag through
+ * tag + partitions - 1 are reserved for this transfer. Producers may call ready from any thread. Unless MPI provides
+ * MPI_THREAD_MULTIPLE, ready on a thread other than the owning thread only marks the partition and the owning thread
+ * hands marked partitions to MPI in progress and wait, so those partitions overlap with production only as far as the
+ * owning thread calls progress while the producers run.
+ */
+class PartitionedSend
+{
+public:
+  /*!
+   * initializes a persistent partitioned send
+   * @param mgr MPI environment providing the communicator
+   * @param buf send buffer holding partitions * count elements
+   * @param partitions number of partitions
+   * @param count elements per partition
+   * @param type element datatype
+   * @param dest destination rank
+   * @param tag message tag
+   */
+  PartitionedSend(MPIManager& mgr, const void* buf, int partitions, int count, MPI_Datatype type, int dest, int tag);
+
+  /*!
+   * frees the persistent requests, the transfer must not be active
+   */
+  ~PartitionedSend();
+
+  PartitionedSend(const PartitionedSend&) = delete;
+  PartitionedSend& operator=(const PartitionedSend&) = delete;
+
+  /*!
+   * starts a new transfer with no partition ready, owning thread only
+   */
+  void start();
+
+  /*!
+   * marks a partition as filled, any thread
+   * @param partition partition index
+   */
+  void ready(int partition);
+
+  /*!
+   * hands partitions marked ready to MPI, owning thread only
+   */
+  void progress();
+
+  /*!
+   * completes the transfer, every partition must have been marked ready, owning thread only
+   */
+  void wait();
+
+private:
+  /// number of partitions
+  int partitions;
+
+  /// boolean stating if ready may call MPI directly from any thread
+  bool direct;
+
+  /// thread that constructed the send, which may always call MPI
+  std::thread::id owner;
+
+  /// partitioned request
+  MPI_Request request = MPI_REQUEST_NULL;
+
+  /// persistent send per partition of the emulation
+  std::vector<MPI_Request> requests;
+
+  /// partitions marked ready but not yet handed to MPI
+  std::unique_ptr<std::atomic<bool>[]> marked;
+};
+
+/*!
+ * partitioned receive matching a PartitionedSend
+ */
+class PartitionedRecv
+{
+public:
+  /*!
+   * initializes a persistent partitioned receive
+   * @param mgr MPI environment providing the communicator
+   * @param buf receive buffer holding partitions * count elements
+   * @param partitions number of partitions
+   * @param count elements per partition
+   * @param type element datatype
+   * @param source source rank
+   * @param tag message tag
+   */
+  PartitionedRecv(MPIManager& mgr, void* buf, int partitions, int count, MPI_Datatype type, int source, int tag);
+
+  /*!
+   * frees the persistent requests, the transfer must not be active
+   */
+  ~PartitionedRecv();
+
+  PartitionedRecv(const PartitionedRecv&) = delete;
+  PartitionedRecv& operator=(const PartitionedRecv&) = delete;
+
+  /*!
+   * starts a new transfer
+   */
+  void start();
+
+  /*!
+   * checks if a partition has arrived, so consumers can start on it before the whole message is in
+   * @param partition partition index
+   * @return boolean stating if the partition has arrived
+   */
+  bool arrived(int partition);
+
+  /*!
+   * completes the transfer
+   */
+  void wait();
+
+private:
+  /// partitioned request
+  MPI_Request request = MPI_REQUEST_NULL;
+
+  /// persistent receive per partition of the emulation
+  std::vector<MPI_Request> requests;
+
+  /// partitions known to have arrived during the current transfer
+  std::vector<bool> done;
+};
+
+#endif //MPIMANAGER_PARTITIONED_H
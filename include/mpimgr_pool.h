@@ -0,0 +1,338 @@
+#ifndef MPIMANAGER_POOL_H
+#define MPIMANAGER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/*!
+ * loop scheduling strategies of ThreadPool::parallel_for
+ */
+enum class Schedule
+{
+  /// one contiguous chunk per participating thread, chunk sizes are fixed up front (OpenMP static)
+  fixed,
+
+  /// threads repeatedly claim chunks of a fixed size (OpenMP dynamic)
+  dynamic,
+
+  /// threads repeatedly claim chunks proportional to the remaining iterations (OpenMP guided)
+  guided,
+};
+
+class ThreadPool;
+
+/*!
+ * set of spawned tasks that can be joined together
+ */
+class TaskGroup
+{
+  friend class ThreadPool;
+
+  /// number of spawned tasks that have not finished
+  std::atomic<std::size_t> pending{0};
+
+  /// set by the first task of the group that threw
+  std::atomic<bool> failed{false};
+
+  /// exception of the first task that threw, rethrown by ThreadPool::join
+  std::exception_ptr error;
+};
+
+/*!
+ * unit of work queued in a ThreadPool
+ */
+struct Task
+{
+  /// work to run
+  std::function<void()> fn;
+
+  /// group notified on completion
+  TaskGroup* group;
+};
+
+/*!
+ * Chase-Lev work-stealing deque, the owner pushes and pops at the bottom while thieves steal from the top
+ */
+class WorkDeque
+{
+public:
+  /*!
+   * constructs an empty deque
+   * @param capacity initial capacity, must be a power of two
+   */
+  explicit WorkDeque(std::int64_t capacity = 256);
+
+  /*!
+   * pushes a task at the bottom, owner only
+   * @param task task to push
+   */
+  void push(Task* task);
+
+  /*!
+   * pops the most recently pushed task, owner only
+   * @return task or nullptr if the deque is empty
+   */
+  Task* pop();
+
+  /*!
+   * steals the least recently pushed task, any thread
+   * @return task or nullptr if the deque is empty or the steal lost a race
+   */
+  Task* steal();
+
+  /*!
+   * checks if the deque appears empty, any thread
+   * @return boolean stating if the deque appears empty
+   */
+  [[nodiscard]] bool empty() const;
+
+private:
+  /*!
+   * circular array of task slots
+   */
+  struct Buffer
+  {
+    /// number of slots, a power of two
+    std::int64_t capacity;
+
+    /// slots
+    std::unique_ptr<std::atomic<Task*>[]> slots;
+  };
+
+  /// index of the next task to steal
+  alignas(64) std::atomic<std::int64_t> top{0};
+
+  /// index of the next free slot
+  alignas(64) std::atomic<std::int64_t> bottom{0};
+
+  /// current buffer
+  std::atomic<Buffer*> buffer;
+
+  /// all buffers ever allocated, kept alive because thieves may still read outgrown ones
+  std::vector<std::unique_ptr<Buffer>> buffers;
+};
+
+/*!
+ * busy and idle time of one pool thread
+ */
+struct ThreadTimes
+{
+  /// seconds spent running tasks
+  double busy = 0.0;
+
+  /// seconds spent looking for or waiting on tasks
+  double idle = 0.0;
+};
+
+/*!
+ * work-stealing thread pool, workers are pinned to the CPUs of the calling thread's affinity mask and park on a futex when idle
+ */
+class ThreadPool
+{
+public:
+  /*!
+   * starts worker threads
+   * @param workers number of worker threads, zero runs every task on the joining thread, none starts one worker per CPU in the affinity mask except one left for the calling thread
+   */
+  explicit ThreadPool(std::optional<std::size_t> workers = std::nullopt);
+
+  /*!
+   * stops and joins worker threads, pending tasks are abandoned
+   */
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /*!
+   * queues a task
+   * @param group group to add the task to
+   * @param fn work to run
+   */
+  void spawn(TaskGroup& group, std::function<void()> fn);
+
+  /*!
+   * runs queued tasks on the calling thread until all tasks of a group have finished, then rethrows the first
+   * exception a task of the group threw, if any
+   * @param group group to join
+   */
+  void join(TaskGroup& group);
+
+  /*!
+   * runs one queued task on the calling thread, letting threads that poll for other work contribute to the pool
+   * @return boolean stating if a task was run
+   */
+  bool help();
+
+  /*!
+   * runs body(i) for every i in [begin, end) across the pool and the calling thread, if a body throws the remaining
+   * chunks are skipped and the first exception is rethrown once every thread left the loop
+   * @tparam F callable taking a std::size_t
+   * @param begin first index
+   * @param end one past the last index
+   * @param body loop body
+   * @param schedule chunking strategy
+   * @param chunk chunk size for dynamic scheduling and minimum chunk size for guided scheduling, zero picks a default
+   */
+  template <class F>
+  void parallel_for(std::size_t begin, std::size_t end, F&& body, Schedule schedule = Schedule::fixed,
+                    std::size_t chunk = 0);
+
+  /*!
+   * returns the number of threads taking part in parallel_for
+   * @return worker count plus one for the calling thread
+   */
+  [[nodiscard]] std::size_t concurrency() const;
+
+  /*!
+   * returns busy and idle times of all worker threads
+   * @return times by worker
+   */
+  [[nodiscard]] std::vector<ThreadTimes> times() const;
+
+private:
+  /*!
+   * state of one worker thread
+   */
+  struct Worker
+  {
+    /// tasks spawned by this worker
+    WorkDeque deque;
+
+    /// nanoseconds spent running tasks
+    std::atomic<std::uint64_t> busy{0};
+
+    /// nanoseconds spent looking for or waiting on tasks
+    std::atomic<std::uint64_t> idle{0};
+
+    /// thread
+    std::thread thread;
+  };
+
+  /*!
+   * worker thread main loop
+   * @param index worker index
+   * @param cpu CPU to pin to, negative to leave unpinned
+   */
+  void work(std::size_t index, int cpu);
+
+  /*!
+   * finds a task for the calling thread
+   * @return task or nullptr if none was found
+   */
+  Task* find();
+
+  /*!
+   * runs a task, keeps its exception in its group and notifies the group
+   * @param task task to run
+   */
+  static void run(Task* task);
+
+  /*!
+   * wakes parked workers after new tasks were queued
+   */
+  void notify();
+
+  /// workers
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  /// guards injected
+  std::mutex injected_mutex;
+
+  /// tasks spawned by threads outside the pool
+  std::deque<Task*> injected;
+
+  /// number of tasks in injected
+  std::atomic<std::size_t> injected_size{0};
+
+  /// futex word incremented whenever tasks are queued
+  alignas(64) std::atomic<std::uint32_t> epoch{0};
+
+  /// number of parked or parking workers
+  alignas(64) std::atomic<std::uint32_t> sleepers{0};
+
+  /// set when the pool is being destroyed
+  std::atomic<bool> stopping{false};
+};
+
+template <class F>
+void ThreadPool::parallel_for(const std::size_t begin, const std::size_t end, F&& body, const Schedule schedule,
+                              std::size_t chunk)
+{
+  if (end <= begin)
+  {
+    return;
+  }
+
+  const std::size_t n = end - begin;
+  const std::size_t threads = std::min(concurrency(), n);
+  TaskGroup group;
+
+  if (Schedule::fixed == schedule)
+  {
+    for (std::size_t t = 0; t < threads; ++t)
+    {
+      const std::size_t first = begin + n * t / threads;
+      const std::size_t last = begin + n * (t + 1) / threads;
+      spawn(group, [&body, first, last] {
+        for (std::size_t i = first; i < last; ++i)
+        {
+          body(i);
+        }
+      });
+    }
+    join(group);
+    return;
+  }
+
+  chunk = std::max<std::size_t>(1, chunk);
+  std::atomic<std::size_t> next{begin};
+  for (std::size_t t = 0; t < threads; ++t)
+  {
+    spawn(group, [&body, &next, &group, end, chunk, schedule, threads] {
+      while (!group.failed.load(std::memory_order_relaxed))
+      {
+        std::size_t first = next.load(std::memory_order_relaxed);
+        std::size_t size = chunk;
+        if (Schedule::guided == schedule)
+        {
+          // claim half of this thread's share of what remains
+          do
+          {
+            if (first >= end)
+            {
+              return;
+            }
+            size = std::max(chunk, (end - first) / (2 * threads));
+          } while (!next.compare_exchange_weak(first, first + size, std::memory_order_relaxed));
+        }
+        else
+        {
+          first = next.fetch_add(size, std::memory_order_relaxed);
+        }
+        if (first >= end)
+        {
+          return;
+        }
+        const std::size_t last = std::min(end, first + size);
+        for (std::size_t i = first; i < last; ++i)
+        {
+          body(i);
+        }
+      }
+    });
+  }
+  join(group);
+}
+
+#endif //MPIMANAGER_POOL_H
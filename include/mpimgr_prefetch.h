@@ -0,0 +1,124 @@
+#ifndef MPIMANAGER_PREFETCH_H
+#define MPIMANAGER_PREFETCH_H
+
+#include "mpimgr.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+ * byte range of a file read by one rank at one step of a Prefetcher schedule
+ */
+struct PrefetchItem
+{
+  /// file path
+  std::string path;
+
+  /// offset of the first byte
+  std::uint64_t offset = 0;
+
+  /// number of bytes, the rest of the file if the maximum
+  std::uint64_t bytes = std::numeric_limits<std::uint64_t>::max();
+};
+
+/*!
+ * double-buffered reader of a schedule of input files, loading the next item on a background thread while the
+ * current one is in use
+ *
+ * The background thread reads with POSIX I/O rather than MPI, so it works at any MPI thread level.
+ */
+class Prefetcher
+{
+public:
+  /*!
+   * starts loading the first item of a schedule
+   * @param mgr MPI environment providing the communicator, timers and logging
+   * @param schedule byte ranges this rank reads, in the order they are used
+   */
+  Prefetcher(MPIManager& mgr, std::vector<PrefetchItem> schedule);
+
+  /*!
+   * waits for a load in progress and stops the background thread
+   */
+  ~Prefetcher();
+
+  Prefetcher(const Prefetcher&) = delete;
+  Prefetcher& operator=(const Prefetcher&) = delete;
+
+  /*!
+   * makes the next item current, waiting if it has not arrived, and starts loading the one after, must be called on
+   * all ranks, logs a warning with the longest stall if any rank had to wait
+   * @return boolean stating if the item had arrived on this rank before the call
+   */
+  bool swap();
+
+  /*!
+   * returns the data of the current item
+   * @return bytes valid until the next swap
+   */
+  [[nodiscard]] std::span<const std::byte> current() const;
+
+  /*!
+   * returns the schedule index of the current item
+   * @return index, the maximum before the first swap
+   */
+  [[nodiscard]] std::size_t index() const;
+
+  /*!
+   * returns the time this rank waited for items
+   * @return seconds
+   */
+  [[nodiscard]] double stalled() const;
+
+private:
+  /*!
+   * loads requested items into pending until stopped, runs on the background thread
+   * @param stop stop token of the background thread
+   */
+  void load(std::stop_token stop);
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// byte ranges in the order they are used
+  std::vector<PrefetchItem> schedule;
+
+  /// schedule index of the current item
+  std::size_t position = std::numeric_limits<std::size_t>::max();
+
+  /// data of the current item
+  std::vector<std::byte> data;
+
+  /// data of the item being loaded
+  std::vector<std::byte> pending;
+
+  /// schedule index of the item to load
+  std::size_t requested = 0;
+
+  /// boolean stating if a load was requested and has not finished
+  bool loading = true;
+
+  /// error of the last load, empty on success
+  std::string error;
+
+  /// seconds waited for items
+  double stall = 0.0;
+
+  /// guards requested, loading, pending and error
+  std::mutex mutex;
+
+  /// signals load requests and completions
+  std::condition_variable_any cv;
+
+  /// background thread, declared last so it starts after the state it uses
+  std::jthread loader;
+};
+
+#endif //MPIMANAGER_PREFETCH_H
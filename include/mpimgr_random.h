@@ -0,0 +1,103 @@
+#ifndef MPIMANAGER_RANDOM_H
+#define MPIMANAGER_RANDOM_H
+
+#include "mpimgr.h"
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+/*!
+ * Philox4x32-10 counter-based random number stream keyed by (seed, rank, stream, counter)
+ *
+ * Every block of four 32-bit outputs is a pure function of its key and counter, so the numbers a rank draws depend
+ * neither on the number of ranks nor on thread scheduling and any position of the stream can be reached in constant
+ * time. Bulk generation uses AVX-512 or AVX2 when the CPU supports it and yields identical results on every path.
+ */
+class Philox
+{
+public:
+  /// block of four 32-bit outputs
+  using Block = std::array<std::uint32_t, 4>;
+
+  /*!
+   * constructs a stream
+   * @param seed global seed shared by all ranks
+   * @param rank rank the stream belongs to
+   * @param stream independent stream index within the rank
+   */
+  Philox(std::uint64_t seed, std::uint32_t rank, std::uint32_t stream = 0);
+
+  /*!
+   * constructs a stream of the calling rank
+   * @param mgr MPI environment providing the rank
+   * @param seed global seed shared by all ranks
+   * @param stream independent stream index within the rank
+   */
+  Philox(const MPIManager& mgr, std::uint64_t seed, std::uint32_t stream = 0);
+
+  /*!
+   * computes the block at a counter without changing the stream position
+   * @param counter block index
+   * @return block
+   */
+  [[nodiscard]] Block block(std::uint64_t counter) const;
+
+  /*!
+   * fills a buffer with raw 32-bit outputs, consuming one block per four outputs
+   * @param out output buffer
+   */
+  void raw(std::span<std::uint32_t> out);
+
+  /*!
+   * fills a buffer with uniforms in (0, 1) of 53 random bits, consuming one block per two outputs
+   * @param out output buffer
+   */
+  void uniform(std::span<double> out);
+
+  /*!
+   * fills a buffer with uniforms in (0, 1) of 24 random bits, consuming one block per four outputs
+   * @param out output buffer
+   */
+  void uniform(std::span<float> out);
+
+  /*!
+   * fills a buffer with standard normals using the Box-Muller transform, consuming one block per two outputs
+   * @param out output buffer
+   */
+  void normal(std::span<double> out);
+
+  /*!
+   * moves the stream to a block
+   * @param counter block index of the next output
+   */
+  void seek(std::uint64_t counter);
+
+  /*!
+   * returns the stream position
+   * @return block index of the next output
+   */
+  [[nodiscard]] std::uint64_t tell() const;
+
+private:
+  /*!
+   * fills consecutive blocks starting at the stream position and advances it
+   * @param out output of 4 * blocks words
+   * @param blocks number of blocks
+   */
+  void generate(std::uint32_t* out, std::size_t blocks);
+
+  /// key words derived from the seed
+  std::array<std::uint32_t, 2> key;
+
+  /// stream index, third counter word
+  std::uint32_t stream;
+
+  /// rank, fourth counter word
+  std::uint32_t rank;
+
+  /// block index of the next output, first and second counter words
+  std::uint64_t counter = 0;
+};
+
+#endif //MPIMANAGER_RANDOM_H
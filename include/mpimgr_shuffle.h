@@ -0,0 +1,112 @@
+#ifndef MPIMANAGER_SHUFFLE_H
+#define MPIMANAGER_SHUFFLE_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*!
+ * key-value shuffle of a MapReduce job
+ *
+ * The map phase emits pairs that are buffered per destination rank, chosen by a hash of the key. exchange delivers
+ * the buffered pairs with MPI_Alltoallv in rounds of bounded size and may be called repeatedly during the map phase
+ * to bound the send buffers. Received pairs are held in memory until the memory limit is exceeded, then sorted and
+ * spilled as a run to node-local scratch. reduce merges the in-memory pairs with all spilled runs in key order.
+ */
+class Shuffle
+{
+public:
+  /// reduce callback receiving a key and all values shuffled to it
+  using Reducer = std::function<void(std::string_view key, std::span<const std::string_view> values)>;
+
+  /*!
+   * constructs an empty shuffle
+   * @param mgr MPI environment providing the communicator and timers
+   * @param memory_limit bytes of received pairs held in memory before spilling, also bounds each exchange round
+   * @param scratch directory for spilled runs, the system temporary directory if empty
+   */
+  Shuffle(MPIManager& mgr, std::size_t memory_limit = std::size_t{256} << 20, std::filesystem::path scratch = {});
+
+  /*!
+   * removes spilled runs
+   */
+  ~Shuffle();
+
+  Shuffle(const Shuffle&) = delete;
+  Shuffle& operator=(const Shuffle&) = delete;
+
+  /*!
+   * buffers a pair for the rank owning its key
+   * @param key key
+   * @param value value
+   */
+  void emit(std::string_view key, std::string_view value);
+
+  /*!
+   * delivers all buffered pairs to their owning ranks, must be called on all ranks
+   */
+  void exchange();
+
+  /*!
+   * delivers remaining pairs and calls a reducer once per local key in ascending key order, must be called on all
+   * ranks, the shuffle is empty afterwards
+   * @param reducer reduce callback
+   */
+  void reduce(const Reducer& reducer);
+
+  /*!
+   * returns the number of runs spilled to scratch so far
+   * @return run count
+   */
+  [[nodiscard]] std::size_t spills() const;
+
+private:
+  /*!
+   * stores a received pair, spilling when the memory limit is exceeded
+   * @param key key
+   * @param value value
+   */
+  void store(std::string_view key, std::string_view value);
+
+  /*!
+   * sorts the in-memory pairs and writes them to a new run
+   */
+  void spill();
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// bytes of received pairs held in memory before spilling
+  std::size_t memory_limit;
+
+  /// directory for spilled runs
+  std::filesystem::path scratch;
+
+  /// distinguishes the runs of shuffles living in the same process
+  std::size_t serial;
+
+  /// serialized outgoing pairs by destination rank
+  std::vector<std::string> outgoing;
+
+  /// received pairs held in memory
+  std::vector<std::pair<std::string, std::string>> received;
+
+  /// approximate bytes held in received
+  std::size_t received_bytes = 0;
+
+  /// spilled runs
+  std::vector<std::filesystem::path> runs;
+
+  /// seconds spent spilling, timed locally since ranks spill different numbers of times
+  double spill_seconds = 0.0;
+};
+
+#endif //MPIMANAGER_SHUFFLE_H
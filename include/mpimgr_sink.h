@@ -0,0 +1,161 @@
+#ifndef MPIMANAGER_SINK_H
+#define MPIMANAGER_SINK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/*!
+ * configuration of a FileSink
+ */
+struct FileSinkOptions
+{
+  /// bytes buffered before they are written with a single pwrite
+  std::size_t buffer = 8 << 20;
+
+  /// seconds after which buffered bytes are written even if the buffer is not full
+  double flush_seconds = 5.0;
+
+  /// bytes reserved with fallocate ahead of the write offset, zero disables preallocation
+  std::size_t preallocate = 64 << 20;
+
+  /// bytes after which the file is rotated, zero disables rotation by size
+  std::size_t rotate_bytes = std::size_t{1} << 30;
+
+  /// seconds after which the file is rotated, zero disables rotation by time
+  double rotate_seconds = 0.0;
+
+  /// gzip rotated files in the background, ignored if zlib was not found at build time
+  bool compress = true;
+
+  /// prefix every line with its wall clock time
+  bool timestamps = true;
+};
+
+/*!
+ * buffered log file appending through pwrite into preallocated space
+ *
+ * Rotated files are renamed to the path followed by a sequence number, then truncated to their size, closed and
+ * optionally compressed by a background thread so logging never waits for them. The same thread writes a buffer that
+ * was not written for the flush interval, so a sink that stops receiving text still reaches the disk.
+ */
+class FileSink
+{
+public:
+  /*!
+   * opens the file for appending
+   * @param path file path
+   * @param options configuration
+   */
+  FileSink(std::string path, FileSinkOptions options = {});
+
+  /*!
+   * writes the buffer, releases the preallocated space and closes the file
+   */
+  ~FileSink();
+
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+
+  /*!
+   * returns if the file could be opened
+   * @return boolean stating if the sink is usable
+   */
+  [[nodiscard]] bool is_open() const;
+
+  /*!
+   * appends text to the buffer, writing it once the buffer is full or its flush interval passed, thread safe
+   * @param text formatted lines
+   */
+  void write(std::string_view text);
+
+  /*!
+   * writes the buffer, thread safe
+   */
+  void flush();
+
+private:
+  /*!
+   * writes the buffer and rotates the file if due, the mutex must be held
+   */
+  void write_buffer();
+
+  /*!
+   * renames the file, queues it for the background thread and opens a new one, the mutex must be held
+   */
+  void rotate();
+
+  /*!
+   * body of the background thread, writes idle buffers and retires rotated files outside the mutex until stopped
+   * @param stop token requesting the thread to finish once every rotated file is retired
+   */
+  void run(std::stop_token stop);
+
+  /*!
+   * opens the file at the path and resumes at its end
+   */
+  void open_file();
+
+  /// file path
+  std::string path;
+
+  /// configuration
+  FileSinkOptions options;
+
+  /// guards all members below
+  std::mutex mutex;
+
+  /// file descriptor, -1 if the file could not be opened
+  int fd = -1;
+
+  /// write offset in bytes
+  std::size_t offset = 0;
+
+  /// end of the preallocated space in bytes
+  std::size_t reserved = 0;
+
+  /// bytes waiting to be written
+  std::string buffer;
+
+  /// time of the last write
+  std::chrono::steady_clock::time_point flushed;
+
+  /// time the file was opened
+  std::chrono::steady_clock::time_point opened;
+
+  /// number of the next rotated file
+  std::size_t rotation = 1;
+
+  /// boolean stating if a write failed, which is reported once
+  bool failed = false;
+
+  /// rotated file waiting to be truncated, closed and compressed
+  struct Rotated
+  {
+    /// file descriptor
+    int fd;
+
+    /// bytes written to the file
+    std::size_t size;
+
+    /// path of the rotated file
+    std::string path;
+  };
+
+  /// rotated files not yet retired
+  std::deque<Rotated> rotated;
+
+  /// wakes the background thread for a rotated file
+  std::condition_variable_any wake;
+
+  /// background thread, declared last so it starts after and stops before the members it uses
+  std::jthread background;
+};
+
+#endif //MPIMANAGER_SINK_H
@@ -0,0 +1,200 @@
+#ifndef MPIMANAGER_SKETCH_H
+#define MPIMANAGER_SKETCH_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/*!
+ * KLL quantile sketch, one-pass and mergeable with rank error of roughly 1.7 / k in memory bounded by about 3 * k
+ * values
+ */
+class KLLSketch
+{
+public:
+  /// maximum number of levels, enough for 2^64 values
+  static constexpr std::size_t max_levels = 64;
+
+  /*!
+   * constructs an empty sketch
+   * @param k accuracy parameter, the capacity of the top level
+   */
+  explicit KLLSketch(std::uint32_t k = 200);
+
+  /*!
+   * adds a value
+   * @param value value to add
+   */
+  void add(double value);
+
+  /*!
+   * adds values in bulk
+   * @param values values to add
+   */
+  void add(std::span<const double> values);
+
+  /*!
+   * merges another sketch into this one
+   * @param other sketch with the same k
+   */
+  void merge(const KLLSketch& other);
+
+  /*!
+   * estimates a quantile
+   * @param q quantile in [0, 1]
+   * @return estimated value, NaN if the sketch is empty
+   */
+  [[nodiscard]] double quantile(double q) const;
+
+  /*!
+   * returns the number of values added
+   * @return count
+   */
+  [[nodiscard]] std::uint64_t count() const;
+
+  /*!
+   * returns the smallest value added
+   * @return minimum
+   */
+  [[nodiscard]] double min() const;
+
+  /*!
+   * returns the largest value added
+   * @return maximum
+   */
+  [[nodiscard]] double max() const;
+
+  /*!
+   * returns the accuracy parameter
+   * @return k
+   */
+  [[nodiscard]] std::uint32_t accuracy() const;
+
+  /*!
+   * returns the size of serialize output, identical for all sketches of the same k
+   * @param k accuracy parameter
+   * @return bytes
+   */
+  [[nodiscard]] static std::size_t serialized_size(std::uint32_t k);
+
+  /*!
+   * writes the sketch to a fixed size buffer
+   * @param out buffer of serialized_size(k) bytes
+   */
+  void serialize(std::span<std::byte> out) const;
+
+  /*!
+   * reads a sketch written by serialize
+   * @param in buffer of serialized_size(k) bytes
+   * @return sketch
+   */
+  [[nodiscard]] static KLLSketch deserialize(std::span<const std::byte> in);
+
+private:
+  /*!
+   * returns the capacity of a level
+   * @param level level index
+   * @return capacity
+   */
+  [[nodiscard]] std::size_t capacity(std::size_t level) const;
+
+  /*!
+   * compacts levels until the sketch fits its capacity
+   */
+  void compress();
+
+  /// accuracy parameter
+  std::uint32_t k;
+
+  /// number of values added
+  std::uint64_t n = 0;
+
+  /// smallest value added
+  double lowest;
+
+  /// largest value added
+  double highest;
+
+  /// alternates which half of a compacted level is promoted
+  std::uint64_t coin = 0;
+
+  /// values by level, a value on level h stands for 2^h values
+  std::vector<std::vector<double>> levels;
+};
+
+/*!
+ * HyperLogLog cardinality sketch with 2^precision one-byte registers and relative error of roughly
+ * 1.04 / sqrt(2^precision)
+ */
+class HyperLogLog
+{
+public:
+  /*!
+   * constructs an empty sketch
+   * @param precision number of index bits in [4, 18]
+   */
+  explicit HyperLogLog(int precision = 14);
+
+  /*!
+   * adds a key
+   * @param key key to add, hashed internally
+   */
+  void add(std::uint64_t key);
+
+  /*!
+   * adds keys in bulk, hashing them in batches that vectorize before updating registers
+   * @param keys keys to add
+   */
+  void add(std::span<const std::uint64_t> keys);
+
+  /*!
+   * merges another sketch into this one
+   * @param other sketch with the same precision
+   */
+  void merge(const HyperLogLog& other);
+
+  /*!
+   * estimates the number of distinct keys added
+   * @return estimated cardinality
+   */
+  [[nodiscard]] double estimate() const;
+
+  /*!
+   * returns the registers
+   * @return registers
+   */
+  [[nodiscard]] std::span<std::uint8_t> registers();
+
+private:
+  /*!
+   * updates the register selected by a hash
+   * @param hash 64-bit hash
+   */
+  void update(std::uint64_t hash);
+
+  /// number of index bits
+  int precision;
+
+  /// registers
+  std::vector<std::uint8_t> regs;
+};
+
+/*!
+ * merges a KLL sketch across ranks with a custom MPI_Op in a reduction tree, must be called on all ranks with the
+ * same k
+ * @param mgr MPI environment providing the communicator
+ * @param sketch local sketch, replaced by the global sketch on all ranks
+ */
+void allreduce(MPIManager& mgr, KLLSketch& sketch);
+
+/*!
+ * merges a HyperLogLog sketch across ranks, must be called on all ranks with the same precision
+ * @param mgr MPI environment providing the communicator
+ * @param sketch local sketch, replaced by the global sketch on all ranks
+ */
+void allreduce(MPIManager& mgr, HyperLogLog& sketch);
+
+#endif //MPIMANAGER_SKETCH_H
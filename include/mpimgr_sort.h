@@ -0,0 +1,646 @@
+#ifndef MPIMANAGER_SORT_H
+#define MPIMANAGER_SORT_H
+
+#include "mpimgr.h"
+#include "mpimgr_pool.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mpi.h>
+#include <queue>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*!
+ * unnamed file in node-local scratch, removed from the directory on creation so it disappears with the process
+ */
+class ScratchFile
+{
+public:
+  /*!
+   * creates an empty scratch file
+   * @param mgr MPI environment used to abort on I/O errors
+   * @param dir scratch directory, the system temporary directory if empty
+   */
+  ScratchFile(MPIManager& mgr, const std::filesystem::path& dir);
+
+  /*!
+   * closes the file, releasing its storage
+   */
+  ~ScratchFile();
+
+  ScratchFile(const ScratchFile&) = delete;
+  ScratchFile& operator=(const ScratchFile&) = delete;
+
+  /*!
+   * appends bytes with one large sequential write
+   * @param data bytes to append
+   * @return offset the bytes were written at
+   */
+  std::uint64_t append(std::span<const std::byte> data);
+
+  /*!
+   * writes bytes at an offset, aborting on failure so it must be called on the thread that initialized MPI
+   * @param offset file offset
+   * @param data bytes to write
+   */
+  void write(std::uint64_t offset, std::span<const std::byte> data);
+
+  /*!
+   * reads bytes at an offset, aborting on failure so it must be called on the thread that initialized MPI
+   * @param offset file offset
+   * @param data buffer to fill completely
+   */
+  void read(std::uint64_t offset, std::span<std::byte> data) const;
+
+  /*!
+   * reads bytes at an offset without aborting, safe to call from several threads at once
+   * @param offset file offset
+   * @param data buffer to fill completely
+   * @return zero on success, the errno of the failed read otherwise, EIO at an unexpected end of file
+   */
+  [[nodiscard]] int try_read(std::uint64_t offset, std::span<std::byte> data) const;
+
+  /*!
+   * aborts with a read error returned by try_read, must be called on the thread that initialized MPI
+   * @param error errno of the failed read
+   */
+  [[noreturn]] void read_failed(int error) const;
+
+private:
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// file descriptor
+  int fd = -1;
+
+  /// bytes appended so far
+  std::uint64_t size = 0;
+};
+
+/*!
+ * sequential reader of a byte range of a ScratchFile that reads the next block on the thread pool while the current
+ * block is consumed
+ */
+class ReadAhead
+{
+public:
+  /*!
+   * starts reading the first block
+   * @param pool thread pool running the reads
+   * @param file file to read
+   * @param begin first byte of the range
+   * @param end one past the last byte of the range
+   * @param block bytes per read
+   */
+  ReadAhead(ThreadPool& pool, const ScratchFile& file, std::uint64_t begin, std::uint64_t end, std::size_t block);
+
+  /*!
+   * waits for a read in flight
+   */
+  ~ReadAhead();
+
+  ReadAhead(const ReadAhead&) = delete;
+  ReadAhead& operator=(const ReadAhead&) = delete;
+
+  /*!
+   * returns the next block, waiting for its read if it is still in flight, and starts reading the one after
+   * @return block valid until the next call, empty at the end of the range
+   */
+  std::span<const std::byte> next();
+
+private:
+  /*!
+   * starts reading the next block into pending
+   */
+  void prefetch();
+
+  /// thread pool running the reads
+  ThreadPool& pool;
+
+  /// file to read
+  const ScratchFile& file;
+
+  /// first byte not yet requested
+  std::uint64_t position;
+
+  /// one past the last byte of the range
+  std::uint64_t end;
+
+  /// bytes per read
+  std::size_t block;
+
+  /// block handed out by next
+  std::vector<std::byte> current;
+
+  /// block being read
+  std::vector<std::byte> pending;
+
+  /// read in flight
+  TaskGroup group;
+
+  /// errno of the read in flight, raised on the calling thread by next
+  int error = 0;
+
+  /// boolean stating if a read is in flight
+  bool in_flight = false;
+};
+
+/*!
+ * external-memory distributed sort of trivially copyable values for datasets larger than aggregate memory
+ *
+ * Values added on each rank are sorted into runs that are written to node-local scratch. sort then selects global
+ * splitters from samples of all runs, streams every run segment to its destination rank in rounds of bounded size,
+ * merges the received segments with read-ahead and writes the globally sorted sequence to a shared file with MPI-IO,
+ * each rank writing its contiguous part. The collective phases are timed as `ExternalSort splitters`,
+ * `ExternalSort exchange` and `ExternalSort merge`, runs are timed with a local clock since ranks write different
+ * numbers of them, and the throughput of all phases is logged.
+ * @tparam T value type
+ * @tparam Compare strict weak ordering of values
+ */
+template <class T, class Compare = std::less<T>>
+class ExternalSort
+{
+  static_assert(std::is_trivially_copyable_v<T>, "ExternalSort values are moved as raw bytes");
+
+public:
+  /*!
+   * constructs an empty sort
+   * @param mgr MPI environment providing the communicator, thread pool and timers
+   * @param memory_limit bytes of values held in memory per rank, must be the same on all ranks
+   * @param scratch directory for runs, the system temporary directory if empty
+   * @param compare ordering of values
+   */
+  explicit ExternalSort(MPIManager& mgr, std::size_t memory_limit = std::size_t{1} << 30,
+                        std::filesystem::path scratch = {}, Compare compare = {});
+
+  /*!
+   * adds values, sorting and writing a run whenever the memory budget is full
+   * @param values values to add
+   */
+  void add(std::span<const T> values);
+
+  /*!
+   * sorts all added values across ranks into a shared file, must be called on all ranks, the sort is empty
+   * afterwards
+   * @param path output file holding the sorted values as raw bytes
+   * @return number of values written by this rank
+   */
+  std::uint64_t sort(const std::string& path);
+
+private:
+  /// a sorted run in the runs file
+  struct Run
+  {
+    /// offset of the first value in bytes
+    std::uint64_t offset;
+
+    /// number of values
+    std::uint64_t count;
+  };
+
+  /*!
+   * sorts the buffered values and appends them to the runs file
+   */
+  void write_run();
+
+  /*!
+   * reads one value of a run
+   * @param run run
+   * @param index value index within the run
+   * @return value
+   */
+  T value_at(const Run& run, std::uint64_t index) const;
+
+  /*!
+   * runs a phase under a timer, only for phases every rank enters the same number of times
+   * @tparam F callable
+   * @param name timer name
+   * @param fn phase
+   * @return seconds spent in this call
+   */
+  template <class F>
+  double timed(const std::string& name, F&& fn);
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// values held in memory before a run is written
+  std::size_t capacity;
+
+  /// directory for runs
+  std::filesystem::path scratch;
+
+  /// ordering of values
+  Compare compare;
+
+  /// values of the run being formed
+  std::vector<T> buffer;
+
+  /// sorted runs, created with the first run
+  std::unique_ptr<ScratchFile> runs_file;
+
+  /// runs written so far
+  std::vector<Run> runs;
+
+  /// evenly spaced samples of every run
+  std::vector<T> samples;
+
+  /// seconds spent forming runs
+  double run_seconds = 0.0;
+};
+
+template <class T, class Compare>
+ExternalSort<T, Compare>::ExternalSort(MPIManager& mgr, const std::size_t memory_limit, std::filesystem::path scratch,
+                                       Compare compare)
+    : mgr(mgr), capacity(std::max<std::size_t>(memory_limit / 2 / sizeof(T), 1)), scratch(std::move(scratch)),
+      compare(std::move(compare))
+{
+}
+
+template <class T, class Compare>
+void ExternalSort<T, Compare>::add(std::span<const T> values)
+{
+  while (!values.empty())
+  {
+    if (buffer.capacity() < capacity)
+    {
+      buffer.reserve(capacity);
+    }
+    const std::size_t take = std::min(values.size(), capacity - buffer.size());
+    buffer.insert(buffer.end(), values.begin(), values.begin() + take);
+    values = values.subspan(take);
+    if (buffer.size() == capacity)
+    {
+      write_run();
+    }
+  }
+}
+
+template <class T, class Compare>
+std::uint64_t ExternalSort<T, Compare>::sort(const std::string& path)
+{
+  if (!buffer.empty())
+  {
+    write_run();
+  }
+  std::vector<T>().swap(buffer);
+  if (!runs_file)
+  {
+    runs_file = std::make_unique<ScratchFile>(mgr, scratch);
+  }
+  const int size = mgr.size;
+  const auto width = static_cast<std::uint64_t>(sizeof(T));
+
+  // splitters are evenly spaced in the sorted union of all samples
+  std::vector<T> splitters;
+  const double splitter_seconds = timed("ExternalSort splitters", [&] {
+    int local = static_cast<int>(samples.size() * sizeof(T));
+    std::vector<int> counts(size), displs(size);
+    MPI_Allgather(&local, 1, MPI_INT, counts.data(), 1, MPI_INT, mgr.comm);
+    int total = 0;
+    for (int i = 0; i < size; ++i)
+    {
+      displs[i] = total;
+      total += counts[i];
+    }
+    std::vector<T> all(static_cast<std::size_t>(total) / sizeof(T));
+    MPI_Allgatherv(samples.data(), local, MPI_BYTE, all.data(), counts.data(), displs.data(), MPI_BYTE, mgr.comm);
+    std::sort(all.begin(), all.end(), compare);
+    if (!all.empty())
+    {
+      for (int i = 1; i < size; ++i)
+      {
+        splitters.push_back(all[all.size() * i / size]);
+      }
+    }
+  });
+  samples.clear();
+
+  // split every run at the splitters by binary search over the runs file,
+  // segment r of destination d being values [bounds[r][d], bounds[r][d + 1])
+  std::vector<std::vector<std::uint64_t>> bounds(runs.size());
+  for (std::size_t r = 0; r < runs.size(); ++r)
+  {
+    auto& bound = bounds[r];
+    bound.assign(size + 1, 0);
+    bound[size] = runs[r].count;
+    for (std::size_t d = 1; d < static_cast<std::size_t>(size); ++d)
+    {
+      std::uint64_t lo = bound[d - 1];
+      std::uint64_t hi = runs[r].count;
+      if (!splitters.empty())
+      {
+        while (lo < hi)
+        {
+          const auto mid = lo + (hi - lo) / 2;
+          if (compare(value_at(runs[r], mid), splitters[d - 1]))
+          {
+            lo = mid + 1;
+          }
+          else
+          {
+            hi = mid;
+          }
+        }
+      }
+      bound[d] = lo;
+    }
+  }
+
+  // destinations learn the segment lengths of every source run
+  const int local_runs = static_cast<int>(runs.size());
+  std::vector<int> source_runs(size);
+  MPI_Allgather(&local_runs, 1, MPI_INT, source_runs.data(), 1, MPI_INT, mgr.comm);
+  std::vector<std::uint64_t> send_lengths(runs.size() * size);
+  for (int d = 0; d < size; ++d)
+  {
+    for (std::size_t r = 0; r < runs.size(); ++r)
+    {
+      send_lengths[d * runs.size() + r] = bounds[r][d + 1] - bounds[r][d];
+    }
+  }
+  std::vector<int> scounts(size), sdispls(size), rcounts(size), rdispls(size);
+  int received_segments = 0;
+  for (int i = 0; i < size; ++i)
+  {
+    scounts[i] = local_runs;
+    sdispls[i] = i * local_runs;
+    rcounts[i] = source_runs[i];
+    rdispls[i] = received_segments;
+    received_segments += source_runs[i];
+  }
+  std::vector<std::uint64_t> recv_lengths(received_segments);
+  MPI_Alltoallv(send_lengths.data(), scounts.data(), sdispls.data(), MPI_UINT64_T, recv_lengths.data(),
+                rcounts.data(), rdispls.data(), MPI_UINT64_T, mgr.comm);
+
+  std::vector<std::uint64_t> send_total(size, 0), recv_total(size, 0), recv_base(size, 0);
+  std::uint64_t largest = 0;
+  std::uint64_t local_count = 0;
+  for (int i = 0; i < size; ++i)
+  {
+    for (std::size_t r = 0; r < runs.size(); ++r)
+    {
+      send_total[i] += send_lengths[i * runs.size() + r];
+    }
+    for (int j = 0; j < source_runs[i]; ++j)
+    {
+      recv_total[i] += recv_lengths[rdispls[i] + j];
+    }
+    recv_base[i] = local_count;
+    local_count += recv_total[i];
+    largest = std::max(largest, send_total[i]);
+  }
+
+  // stream segments in rounds of at most share values per pair of ranks,
+  // packing the next round while the current one is in flight
+  const std::uint64_t share =
+      std::max<std::uint64_t>(std::min<std::uint64_t>(capacity / 2, INT_MAX / 2 / width) / size, 1);
+  std::uint64_t rounds = (largest + share - 1) / share;
+  MPI_Allreduce(MPI_IN_PLACE, &rounds, 1, MPI_UINT64_T, MPI_MAX, mgr.comm);
+  auto received = std::make_unique<ScratchFile>(mgr, scratch);
+  const double exchange_seconds = timed("ExternalSort exchange", [&] {
+    std::vector<std::uint64_t> sent(size, 0), got(size, 0);
+    std::vector<int> pack_counts(size), pack_displs(size), round_rcounts(size), round_rdispls(size);
+    std::vector<std::byte> packing, in_flight, incoming;
+
+    const auto pack = [&] {
+      packing.clear();
+      for (int d = 0; d < size; ++d)
+      {
+        const auto take = std::min(share, send_total[d] - sent[d]);
+        pack_displs[d] = static_cast<int>(packing.size());
+        pack_counts[d] = static_cast<int>(take * width);
+        // walk the segments of destination d from where the last round ended
+        std::uint64_t skip = sent[d];
+        std::uint64_t left = take;
+        for (std::size_t r = 0; r < runs.size() && left > 0; ++r)
+        {
+          const auto length = bounds[r][d + 1] - bounds[r][d];
+          if (skip >= length)
+          {
+            skip -= length;
+            continue;
+          }
+          const auto n = std::min(left, length - skip);
+          const auto at = packing.size();
+          packing.resize(at + n * width);
+          runs_file->read(runs[r].offset + (bounds[r][d] + skip) * width, std::span(packing).subspan(at));
+          left -= n;
+          skip = 0;
+        }
+        sent[d] += take;
+      }
+    };
+
+    std::vector<int> send_counts(size), send_displs(size);
+    pack();
+    for (std::uint64_t round = 0; round < rounds; ++round)
+    {
+      in_flight.swap(packing);
+      send_counts.swap(pack_counts);
+      send_displs.swap(pack_displs);
+      int bytes = 0;
+      for (int s = 0; s < size; ++s)
+      {
+        round_rdispls[s] = bytes;
+        round_rcounts[s] = static_cast<int>(std::min(share, recv_total[s] - got[s]) * width);
+        bytes += round_rcounts[s];
+      }
+      incoming.resize(bytes);
+      MPI_Request request;
+      MPI_Ialltoallv(in_flight.data(), send_counts.data(), send_displs.data(), MPI_BYTE, incoming.data(),
+                     round_rcounts.data(), round_rdispls.data(), MPI_BYTE, mgr.comm, &request);
+      if (round + 1 < rounds)
+      {
+        pack();
+      }
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      for (int s = 0; s < size; ++s)
+      {
+        if (round_rcounts[s] > 0)
+        {
+          received->write((recv_base[s] + got[s]) * width,
+                          std::span(incoming).subspan(round_rdispls[s], round_rcounts[s]));
+          got[s] += static_cast<std::uint64_t>(round_rcounts[s]) / width;
+        }
+      }
+    }
+  });
+  runs_file.reset();
+  runs.clear();
+
+  // every received segment is sorted, merge them while writing the output
+  // with non-blocking MPI-IO from a second buffer
+  std::uint64_t offset = 0;
+  MPI_Exscan(&local_count, &offset, 1, MPI_UINT64_T, MPI_SUM, mgr.comm);
+  if (0 == mgr.rank)
+  {
+    offset = 0;
+  }
+  std::uint64_t global_count = local_count;
+  MPI_Allreduce(MPI_IN_PLACE, &global_count, 1, MPI_UINT64_T, MPI_SUM, mgr.comm);
+
+  MPI_File fh;
+  if (MPI_SUCCESS != MPI_File_open(mgr.comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh))
+  {
+    mgr.abort(fmt::format("ExternalSort: cannot open output `{}`", path));
+  }
+  MPI_File_set_size(fh, static_cast<MPI_Offset>(global_count * width));
+
+  const double merge_seconds = timed("ExternalSort merge", [&] {
+    auto& pool = mgr.pool();
+    const std::size_t segments = recv_lengths.size();
+    // reads below 64 KiB cost more in latency than they save in memory
+    const std::size_t block =
+        std::max<std::size_t>(capacity / 2 / std::max<std::size_t>(segments, 1), (64 << 10) / width + 1) * width;
+    std::vector<std::unique_ptr<ReadAhead>> readers;
+    std::uint64_t position = 0;
+    for (const auto length : recv_lengths)
+    {
+      readers.push_back(
+          std::make_unique<ReadAhead>(pool, *received, position * width, (position + length) * width, block));
+      position += length;
+    }
+
+    // cursor i holds the current block of reader i and the position in it
+    std::vector<std::span<const std::byte>> blocks(segments);
+    std::vector<T> heads(segments);
+    const auto advance = [&](const std::size_t i) {
+      if (blocks[i].empty())
+      {
+        blocks[i] = readers[i]->next();
+        if (blocks[i].empty())
+        {
+          return false;
+        }
+      }
+      std::memcpy(&heads[i], blocks[i].data(), sizeof(T));
+      blocks[i] = blocks[i].subspan(sizeof(T));
+      return true;
+    };
+    const auto later = [&](const std::size_t a, const std::size_t b) { return compare(heads[b], heads[a]); };
+    std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heap(later);
+    for (std::size_t i = 0; i < segments; ++i)
+    {
+      if (advance(i))
+      {
+        heap.push(i);
+      }
+    }
+
+    // values are written as one contiguous type each, so a write never holds
+    // more than INT_MAX of them
+    const std::size_t out_capacity = std::clamp<std::size_t>(capacity / 4, 1, INT_MAX);
+    MPI_Datatype value_type;
+    MPI_Type_contiguous(static_cast<int>(sizeof(T)), MPI_BYTE, &value_type);
+    MPI_Type_commit(&value_type);
+    std::vector<T> filling, writing;
+    filling.reserve(out_capacity);
+    MPI_Request request = MPI_REQUEST_NULL;
+    std::uint64_t written = offset;
+    const auto flush = [&] {
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+      writing.swap(filling);
+      filling.clear();
+      MPI_File_iwrite_at(fh, static_cast<MPI_Offset>(written * width), writing.data(),
+                         static_cast<int>(writing.size()), value_type, &request);
+      written += writing.size();
+    };
+    while (!heap.empty())
+    {
+      const auto i = heap.top();
+      heap.pop();
+      filling.push_back(heads[i]);
+      if (filling.size() == out_capacity)
+      {
+        flush();
+      }
+      if (advance(i))
+      {
+        heap.push(i);
+      }
+    }
+    if (!filling.empty())
+    {
+      flush();
+    }
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    MPI_Type_free(&value_type);
+  });
+  MPI_File_close(&fh);
+
+  // throughput of the slowest rank in every phase
+  double seconds[4] = {run_seconds, splitter_seconds, exchange_seconds, merge_seconds};
+  MPI_Allreduce(MPI_IN_PLACE, seconds, 4, MPI_DOUBLE, MPI_MAX, mgr.comm);
+  const auto mib = 1.0 / (1 << 20) * static_cast<double>(global_count * width);
+  const auto rate = [mib](const double s) { return s > 0.0 ? mib / s : 0.0; };
+  mgr.log(Level::info, fmt::format("ExternalSort: {} values ({:.1f} MiB) sorted into `{}`, runs: {:.3f} s "
+                                   "({:.1f} MiB/s), splitters: {:.3f} s, exchange: {:.3f} s ({:.1f} MiB/s), "
+                                   "merge: {:.3f} s ({:.1f} MiB/s)",
+                                   global_count, mib, path, seconds[0], rate(seconds[0]), seconds[1], seconds[2],
+                                   rate(seconds[2]), seconds[3], rate(seconds[3])));
+  run_seconds = 0.0;
+  return local_count;
+}
+
+template <class T, class Compare>
+void ExternalSort<T, Compare>::write_run()
+{
+  // ranks write different numbers of runs, so an MPIManager timer could
+  // enter the barriers of ordered logging on some ranks only
+  const auto start = std::chrono::steady_clock::now();
+  {
+    std::sort(buffer.begin(), buffer.end(), compare);
+
+    // a fixed number of evenly spaced samples per full run keeps the splitter
+    // gather small while weighting runs by their size
+    const std::size_t stride = std::max<std::size_t>(capacity / 64, 1);
+    for (std::size_t i = stride / 2; i < buffer.size(); i += stride)
+    {
+      samples.push_back(buffer[i]);
+    }
+
+    if (!runs_file)
+    {
+      runs_file = std::make_unique<ScratchFile>(mgr, scratch);
+    }
+    const auto bytes = std::as_bytes(std::span(buffer));
+    runs.push_back({runs_file->append(bytes), buffer.size()});
+    buffer.clear();
+  }
+  run_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class T, class Compare>
+T ExternalSort<T, Compare>::value_at(const Run& run, const std::uint64_t index) const
+{
+  T value;
+  runs_file->read(run.offset + index * sizeof(T), std::as_writable_bytes(std::span(&value, 1)));
+  return value;
+}
+
+template <class T, class Compare>
+template <class F>
+double ExternalSort<T, Compare>::timed(const std::string& name, F&& fn)
+{
+  const auto before = mgr.timer_stats(name);
+  mgr.timer_start(Level::debug, name);
+  fn();
+  mgr.timer_stop();
+  return mgr.timer_stats(name)->total - (before ? before->total : 0.0);
+}
+
+#endif //MPIMANAGER_SORT_H
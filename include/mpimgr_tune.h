@@ -0,0 +1,121 @@
+#ifndef MPIMANAGER_TUNE_H
+#define MPIMANAGER_TUNE_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/// values of the tunable parameters by name
+using TuneConfig = std::map<std::string, std::int64_t>;
+
+/*!
+ * online tuner of kernel parameters driven by MPIManager timers
+ *
+ * The parameter space is the Cartesian product of the registered values, sampled down to a bounded number of
+ * candidates. Successive halving runs every surviving candidate in a round, doubling the runs per candidate each
+ * round, and keeps the faster half judged by the slowest rank's mean time, reduced in one collective per round so all
+ * ranks agree. The last survivor is locked in and cached in a file under a fingerprint of the hardware, job shape and
+ * parameter space, so later runs with the same fingerprint start tuned.
+ */
+class Autotuner
+{
+public:
+  /*!
+   * constructs a tuner with no parameters
+   * @param mgr MPI environment providing the communicator and timers
+   * @param name timer name of the kernel and key of the cache entry
+   * @param cache cache file read and written by rank zero, empty to disable caching
+   * @param max_candidates largest number of configurations explored
+   */
+  Autotuner(MPIManager& mgr, std::string name, std::string cache = "mpimgr_tune.cache",
+            std::size_t max_candidates = 64);
+
+  /*!
+   * registers a tunable parameter, all parameters must be registered before the first run
+   * @param name parameter name
+   * @param values candidate values
+   */
+  void parameter(const std::string& name, std::vector<std::int64_t> values);
+
+  /*!
+   * runs the kernel once under the timer with the configuration under evaluation, or the locked in configuration once
+   * tuning finished, must be called on all ranks the same number of times
+   * @param kernel kernel taking the configuration to use
+   */
+  void run(const std::function<void(const TuneConfig&)>& kernel);
+
+  /*!
+   * returns if tuning finished
+   * @return boolean stating if the best configuration is locked in
+   */
+  [[nodiscard]] bool tuned() const;
+
+  /*!
+   * returns the configuration used by the next run
+   * @return configuration
+   */
+  [[nodiscard]] const TuneConfig& config() const;
+
+private:
+  /*!
+   * builds the candidates and looks up the cache, called by the first run
+   */
+  void start();
+
+  /*!
+   * keeps the faster half of the candidates after a round and locks in the last survivor
+   */
+  void finish_round();
+
+  /*!
+   * returns the fingerprint of the hardware, job shape and parameter space
+   * @return fingerprint, only meaningful on rank zero
+   */
+  [[nodiscard]] std::string fingerprint() const;
+
+  /// MPI environment
+  MPIManager& mgr;
+
+  /// timer name of the kernel
+  std::string name;
+
+  /// cache file
+  std::string cache;
+
+  /// largest number of configurations explored
+  std::size_t max_candidates;
+
+  /// registered parameters in registration order
+  std::vector<std::pair<std::string, std::vector<std::int64_t>>> parameters;
+
+  /// candidate configurations
+  std::vector<TuneConfig> candidates;
+
+  /// indices of the candidates surviving so far
+  std::vector<std::size_t> survivors;
+
+  /// total time of every survivor in the current round
+  std::vector<double> times;
+
+  /// runs per candidate in the current round
+  std::size_t repeats = 1;
+
+  /// runs completed in the current round
+  std::size_t cursor = 0;
+
+  /// runs spent tuning
+  std::size_t iterations = 0;
+
+  /// boolean stating if the candidates were built
+  bool started = false;
+
+  /// boolean stating if the best configuration is locked in
+  bool locked = false;
+};
+
+#endif //MPIMANAGER_TUNE_H
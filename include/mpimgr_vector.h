@@ -0,0 +1,137 @@
+#ifndef MPIMANAGER_VECTOR_H
+#define MPIMANAGER_VECTOR_H
+
+#include "mpimgr.h"
+
+#include <cstddef>
+#include <mpi.h>
+#include <span>
+#include <vector>
+
+/*!
+ * computes y += a * x on local elements
+ * @param a scalar
+ * @param x input vector
+ * @param y input and output vector of the same length as x
+ */
+void axpy(double a, std::span<const double> x, std::span<double> y);
+
+/*!
+ * computes the dot product of local elements
+ * @param x first vector
+ * @param y second vector of the same length as x
+ * @return local dot product
+ */
+[[nodiscard]] double dot_local(std::span<const double> x, std::span<const double> y);
+
+/*!
+ * computes the dot product of a vector distributed across ranks, must be called on all ranks
+ * @param mgr MPI environment providing the communicator
+ * @param x local elements of the first vector
+ * @param y local elements of the second vector
+ * @return global dot product
+ */
+[[nodiscard]] double dot(MPIManager& mgr, std::span<const double> x, std::span<const double> y);
+
+/*!
+ * computes the Euclidean norm of a vector distributed across ranks, must be called on all ranks
+ * @param mgr MPI environment providing the communicator
+ * @param x local elements of the vector
+ * @return global norm
+ */
+[[nodiscard]] double norm(MPIManager& mgr, std::span<const double> x);
+
+/*!
+ * global reductions in flight, to be overlapped with independent work such as the next SpMV
+ */
+class ReductionFuture
+{
+public:
+  /*!
+   * starts a sum allreduce that takes ownership of the local values
+   * @param comm communicator
+   * @param values local values, replaced by global sums on completion
+   */
+  ReductionFuture(MPI_Comm comm, std::vector<double> values);
+
+  /*!
+   * completes the reduction if it is still running
+   */
+  ~ReductionFuture();
+
+  ReductionFuture(ReductionFuture&& other) noexcept;
+  ReductionFuture& operator=(ReductionFuture&& other) noexcept;
+  ReductionFuture(const ReductionFuture&) = delete;
+  ReductionFuture& operator=(const ReductionFuture&) = delete;
+
+  /*!
+   * checks for completion without blocking, also driving MPI progress
+   * @return boolean stating if the global values are available
+   */
+  bool ready();
+
+  /*!
+   * waits for completion
+   * @return global values in the order they were queued
+   */
+  const std::vector<double>& get();
+
+  /*!
+   * waits for completion
+   * @param i index returned when the value was queued
+   * @return global value
+   */
+  double operator[](std::size_t i);
+
+private:
+  /// local values until completion, global values afterwards
+  std::vector<double> values;
+
+  /// request of the running allreduce
+  MPI_Request request = MPI_REQUEST_NULL;
+};
+
+/*!
+ * queue of dot products whose global sums are computed with a single non-blocking allreduce, the building block of
+ * pipelined CG and GMRES variants
+ */
+class DotBatch
+{
+public:
+  /*!
+   * constructs an empty batch
+   * @param mgr MPI environment providing the communicator
+   */
+  explicit DotBatch(MPIManager& mgr);
+
+  /*!
+   * computes a local dot product and queues it for reduction
+   * @param x local elements of the first vector
+   * @param y local elements of the second vector
+   * @return index of the global value in the future
+   */
+  std::size_t queue(std::span<const double> x, std::span<const double> y);
+
+  /*!
+   * queues an already computed local partial sum for reduction
+   * @param value local partial sum
+   * @return index of the global value in the future
+   */
+  std::size_t queue(double value);
+
+  /*!
+   * starts reducing all queued values and empties the batch, must be called on all ranks with the same number of
+   * queued values
+   * @return future of the global values
+   */
+  ReductionFuture start();
+
+private:
+  /// communicator
+  MPI_Comm comm;
+
+  /// queued local values
+  std::vector<double> values;
+};
+
+#endif //MPIMANAGER_VECTOR_H
@@ -1,12 +1,295 @@
 #include "mpimgr.h"
+#include "mpimgr_io.h"
+#include "mpimgr_pool.h"
+
+#include <fmt/ranges.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#ifdef MPIMANAGER_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+/// tag and color of every level, indexed by the level
+constexpr std::pair<const char *, fmt::color> level_styles[] = {
+    {"EMERG", fmt::color::dark_red},   {"ALERT", fmt::color::red},
+    {"CRIT", fmt::color::dark_orange}, {"ERR", fmt::color::orange},
+    {"WARNING", fmt::color::orange},   {"NOTICE", fmt::color::green},
+    {"INFO", fmt::color::blue},        {"DEBUG", fmt::color::purple}};
+
+/// bytes in front of the node-shared log ring holding its reservation counter
+constexpr std::size_t ring_header = 64;
+
+/// power in watts a RAPL domain is assumed never to exceed when spacing reads
+constexpr double energy_peak_watts = 1000.0;
+
+/// bounds in seconds of the interval between reads of the RAPL counters
+constexpr double energy_interval_min = 0.1;
+constexpr double energy_interval_max = 60.0;
+
+/*!
+ * header of a record in the node-shared log ring, followed by the message
+ */
+struct LogRecord {
+  /// bytes of the record including header and padding
+  std::uint32_t bytes;
+
+  /// rank that logged, negative marks the end of the records
+  std::int32_t rank;
+
+  /// level logged at
+  std::int32_t level;
+
+  /// bytes of the message
+  std::uint32_t length;
+
+  /// wall clock time in microseconds since the epoch
+  std::int64_t time;
+};
+
+/*!
+ * returns the wall clock time
+ * @return microseconds since the epoch
+ */
+std::int64_t wall_micros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/*!
+ * formats a log line
+ * @param rank rank that logged
+ * @param level level logged at
+ * @param msg message
+ * @param color boolean stating if terminal colors are added
+ * @return line including the newline
+ */
+std::string format_line(const int rank, const Level level,
+                        const std::string_view msg, const bool color) {
+  const auto &[tag, hue] = level_styles[static_cast<int>(level)];
+  if (!color) {
+    return fmt::format("Rank {}: [{}]: {}\n", rank, tag, msg);
+  }
+  return fmt::format(fmt::emphasis::bold, "Rank {}: ", rank) +
+         fmt::format(fg(hue), "[{}]", tag) + fmt::format(": {}\n", msg);
+}
+
+/*!
+ * formats a log line for a file
+ * @param time wall clock time in microseconds since the epoch
+ * @param rank rank that logged
+ * @param level level logged at
+ * @param msg message
+ * @param timestamps boolean stating if the time prefixes the line
+ * @return line including the newline
+ */
+std::string format_file_line(const std::int64_t time, const int rank,
+                             const Level level, const std::string_view msg,
+                             const bool timestamps) {
+  if (!timestamps) {
+    return format_line(rank, level, msg, false);
+  }
+  return fmt::format(fmt::runtime("{:%Y-%m-%d %H:%M:%S}.{:06} "),
+                     fmt::localtime(static_cast<std::time_t>(time / 1000000)),
+                     time % 1000000) +
+         format_line(rank, level, msg, false);
+}
+
+/*!
+ * packs a batch of log lines, the first byte states if it is compressed,
+ * followed by the uncompressed size if so
+ * @param text log lines
+ * @param compress boolean stating if compression is attempted
+ * @return packed batch
+ */
+std::string pack_batch(const std::string &text, const bool compress) {
+#ifdef MPIMANAGER_ZLIB
+  if (compress && !text.empty()) {
+    const std::uint64_t raw = text.size();
+    uLongf bytes = compressBound(raw);
+    std::string packed(1 + sizeof raw + bytes, '\1');
+    std::memcpy(packed.data() + 1, &raw, sizeof raw);
+    if (Z_OK == compress2(reinterpret_cast<Bytef *>(packed.data()) + 1 +
+                              sizeof raw,
+                          &bytes, reinterpret_cast<const Bytef *>(text.data()),
+                          raw, Z_BEST_SPEED)) {
+      packed.resize(1 + sizeof raw + bytes);
+      return packed;
+    }
+  }
+#endif
+  return '\0' + text;
+}
+
+/*!
+ * unpacks a batch of log lines
+ * @param packed packed batch
+ * @return log lines
+ */
+std::string unpack_batch(const std::string_view packed) {
+  if (packed.empty()) {
+    return {};
+  }
+#ifdef MPIMANAGER_ZLIB
+  if (1 == packed[0]) {
+    std::uint64_t raw = 0;
+    std::memcpy(&raw, packed.data() + 1, sizeof raw);
+    std::string text(raw, '\0');
+    uLongf bytes = raw;
+    uncompress(reinterpret_cast<Bytef *>(text.data()), &bytes,
+               reinterpret_cast<const Bytef *>(packed.data()) + 1 + sizeof raw,
+               packed.size() - 1 - sizeof raw);
+    text.resize(bytes);
+    return text;
+  }
+#endif
+  return std::string(packed.substr(1));
+}
+} // namespace
+
+RankSelector::RankSelector(const Ranks ranks)
+    : select([ranks](const int rank, int) {
+        return Ranks::all == ranks || 0 == rank;
+      }) {}
+
+RankSelector::RankSelector(std::function<bool(int, int)> select)
+    : select(std::move(select)) {}
+
+RankSelector RankSelector::node_leaders() {
+  return RankSelector(
+      std::function<bool(int, int)>([](int, const int node_rank) {
+        return 0 == node_rank;
+      }));
+}
+
+RankSelector RankSelector::list(std::vector<int> ranks) {
+  std::ranges::sort(ranks);
+  return RankSelector(std::function<bool(int, int)>(
+      [ranks = std::move(ranks)](const int rank, int) {
+        return std::ranges::binary_search(ranks, rank);
+      }));
+}
+
+RankSelector RankSelector::stride(const int step, const int first) {
+  return RankSelector(std::function<bool(int, int)>(
+      [step = std::max(step, 1), first](const int rank, int) {
+        return rank >= first && 0 == (rank - first) % step;
+      }));
+}
+
+RankSelector RankSelector::predicate(std::function<bool(int)> select) {
+  return RankSelector(std::function<bool(int, int)>(
+      [select = std::move(select)](const int rank, int) {
+        return select(rank);
+      }));
+}
+
+bool RankSelector::selects(const int rank, const int node_rank) const {
+  return select(rank, node_rank);
+}
 
 MPIManager::MPIManager(int &argc, char **argv, const Level level,
-                       const Ranks ranks) : level(level), ranks(ranks) {
+                       const RankSelector &ranks, const Options &options)
+    : level(level), options(options) {
   // initialize MPI environment
-  MPI_Init(&argc, &argv);
+  MPI_Init_thread(&argc, &argv, options.thread_level, &thread_level);
   comm = MPI_COMM_WORLD;
   MPI_Comm_rank(comm, &rank);
   MPI_Comm_size(comm, &size);
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL,
+                      &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Comm_size(node_comm, &node_size);
+
+  // the selection is evaluated once, ordered output then only synchronizes
+  // the selected ranks
+  log_selected = ranks.selects(rank, node_rank);
+  MPI_Comm_split(comm, log_selected ? 0 : MPI_UNDEFINED, rank, &log_comm);
+  if (log_selected) {
+    MPI_Comm_size(log_comm, &log_size);
+  }
+
+  if (!options.log_file.empty()) {
+    std::string path = options.log_file;
+    if (const auto at = path.find("{rank}"); std::string::npos != at) {
+      path.replace(at, 6, std::to_string(rank));
+    }
+    auto sink = std::make_unique<FileSink>(path, options.log_file_options);
+    if (!sink->is_open()) {
+      abort(fmt::format("Log file `{}` could not be opened.", path));
+    }
+    file_sink = std::move(sink);
+  }
+
+  // the node leader owns the log ring, the other ranks map it
+  if (options.log_aggregate && options.log_file.empty()) {
+    const MPI_Aint bytes =
+        0 == node_rank ? static_cast<MPI_Aint>(ring_header +
+                                               options.log_ring_bytes)
+                       : 0;
+    MPI_Win_allocate_shared(bytes, 1, MPI_INFO_NULL, node_comm, &log_ring,
+                            &log_win);
+    MPI_Aint ring_bytes = 0;
+    int unit = 0;
+    MPI_Win_shared_query(log_win, 0, &ring_bytes, &unit, &log_ring);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, log_win);
+    if (0 == node_rank) {
+      std::atomic_ref(*reinterpret_cast<std::uint64_t *>(log_ring)).store(0);
+    }
+    MPI_Win_sync(log_win);
+    MPI_Barrier(node_comm);
+    MPI_Comm_split(comm, 0 == node_rank ? 0 : MPI_UNDEFINED, rank,
+                   &leader_comm);
+    if (0 == node_rank && !options.log_directory.empty()) {
+      char host[MPI_MAX_PROCESSOR_NAME] = {};
+      int length = 0;
+      MPI_Get_processor_name(host, &length);
+      const auto path = fmt::format("{}/{}.log", options.log_directory, host);
+      auto sink = std::make_unique<FileSink>(path, options.log_file_options);
+      if (!sink->is_open()) {
+        abort(fmt::format("Log file `{}` could not be opened.", path));
+      }
+      node_sink = std::move(sink);
+    }
+  }
+
+  if (options.capture_output) {
+    capture_init();
+  }
+
+  // keep /proc/self/io open so sampling it is a single pread
+  if (options.usage) {
+    io_fd = open("/proc/self/io", O_RDONLY | O_CLOEXEC);
+  }
+
+  // the I/O profiler library is either preloaded or linked, if at all
+  io_hooks = static_cast<const IOHooks *>(
+      dlsym(RTLD_DEFAULT, "mpimgr_io_hooks"));
+
+  if (options.energy) {
+    energy_init();
+  }
+
+  if (options.frequency_interval > 0.0) {
+    frequency_init();
+  }
+
+  sampler_init();
 }
 
 MPIManager::~MPIManager() {
@@ -14,210 +297,358 @@ MPIManager::~MPIManager() {
   if (!timers.empty()) {
     log(Level::warning,
         "Timers are running at the time of environment destruction.");
-    for (auto timer : timers) {
+    while (!timers.empty()) {
       timer_stop();
     }
   }
 
+  if (sampler.joinable()) {
+    sampler.request_stop();
+    sampler.join();
+  }
+
+  // records logged so far precede the reports
+  log_flush();
+  if (options.report) {
+    timer_report();
+    pool_report();
+    io_report();
+  }
+  frequency_report();
+  thread_pool.reset();
+
+  if (-1 != io_fd) {
+    close(io_fd);
+  }
+
+  capture_stop();
+
+  if (MPI_COMM_NULL != log_comm) {
+    MPI_Comm_free(&log_comm);
+  }
+  if (MPI_WIN_NULL != log_win) {
+    log_flush();
+    MPI_Win_unlock_all(log_win);
+    MPI_Win_free(&log_win);
+  }
+  file_sink.reset();
+  node_sink.reset();
+  if (MPI_COMM_NULL != leader_comm) {
+    MPI_Comm_free(&leader_comm);
+  }
+  MPI_Comm_free(&node_comm);
+
   // terminate MPI environment
   MPI_Finalize();
 }
 
 void MPIManager::log(const Level level, const std::string &msg) {
-  if (sufficient_rank() && sufficient_level(level)) {
-    switch (level) {
-    case Level::emerg:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_emerg(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_emerg(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
-      }
-      break;
-    case Level::alert:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_alert(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_alert(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
-      }
-      break;
-    case Level::crit:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_crit(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_crit(msg);
-          }
-          MPI_Barrier(comm);
-        }
+  if (!sufficient_rank() || !sufficient_level(level)) {
+    return;
+  }
+  // every rank has its own file, so no ordering is needed
+  if (file_sink) {
+    log_local(level, msg);
+    return;
+  }
+  if (MPI_WIN_NULL != log_win) {
+    log_append(level, msg);
+    return;
+  }
+  if (1 == log_size) {
+    log_local(level, msg);
+    return;
+  }
+  int log_rank = 0;
+  MPI_Comm_rank(log_comm, &log_rank);
+  for (const auto i : std::views::iota(0, log_size)) {
+    if (log_rank == i) {
+      log_local(level, msg);
+    }
+    MPI_Barrier(log_comm);
+  }
+}
+
+void MPIManager::abort(const std::string &msg) {
+  log_emerg(msg);
+  if (file_sink) {
+    // the reason for aborting also reaches the terminal
+    file_sink->flush();
+    emit(format_line(rank, Level::emerg, msg, true));
+  }
+  MPI_Abort(comm, EXIT_FAILURE);
+}
+
+void MPIManager::log_local(const Level level, const std::string &msg) {
+  if (file_sink) {
+    file_sink->write(format_file_line(wall_micros(), rank, level, msg,
+                                      options.log_file_options.timestamps));
+    return;
+  }
+  emit(format_line(rank, level, msg, true));
+}
+
+void MPIManager::log_append(const Level level, const std::string &msg) {
+  const std::size_t bytes =
+      (sizeof(LogRecord) + msg.size() + 7) & ~std::size_t{7};
+  const std::size_t offset =
+      std::atomic_ref(*reinterpret_cast<std::uint64_t *>(log_ring))
+          .fetch_add(bytes, std::memory_order_relaxed);
+  char *records = log_ring + ring_header;
+  if (offset + bytes > options.log_ring_bytes) {
+    // reservations only grow until the next flush, so at most one record
+    // straddles the end and marks it
+    if (offset + sizeof(LogRecord) <= options.log_ring_bytes) {
+      const LogRecord end{0, -1, 0, 0, 0};
+      std::memcpy(records + offset, &end, sizeof end);
+    }
+    log_local(level, msg);
+    return;
+  }
+  const LogRecord record{static_cast<std::uint32_t>(bytes), rank,
+                         static_cast<std::int32_t>(level),
+                         static_cast<std::uint32_t>(msg.size()),
+                         wall_micros()};
+  std::memcpy(records + offset, &record, sizeof record);
+  std::memcpy(records + offset + sizeof record, msg.data(), msg.size());
+}
+
+void MPIManager::log_flush() {
+  if (file_sink) {
+    file_sink->flush();
+  }
+  if (MPI_WIN_NULL == log_win) {
+    return;
+  }
+
+  // captured lines are appended here since the drain thread must not race
+  // the leader reading the ring
+  std::vector<std::pair<Level, std::string>> lines;
+  {
+    std::lock_guard lock(output_mutex);
+    lines.swap(captured);
+  }
+  for (const auto &[level, msg] : lines) {
+    log_append(level, msg);
+  }
+
+  // every rank of the node finished appending before the leader reads
+  MPI_Win_sync(log_win);
+  MPI_Barrier(node_comm);
+  MPI_Win_sync(log_win);
+  std::string batch;
+  if (0 == node_rank) {
+    std::atomic_ref reserved(*reinterpret_cast<std::uint64_t *>(log_ring));
+    const std::size_t used =
+        std::min<std::size_t>(reserved.load(), options.log_ring_bytes);
+    const char *records = log_ring + ring_header;
+    for (std::size_t offset = 0; offset + sizeof(LogRecord) <= used;) {
+      LogRecord record{};
+      std::memcpy(&record, records + offset, sizeof record);
+      if (record.rank < 0) {
         break;
       }
+      const std::string_view msg(records + offset + sizeof record,
+                                 record.length);
+      batch += node_sink ? format_file_line(
+                               record.time, record.rank,
+                               static_cast<Level>(record.level), msg,
+                               options.log_file_options.timestamps)
+                         : format_line(record.rank,
+                                       static_cast<Level>(record.level), msg,
+                                       true);
+      offset += record.bytes;
+    }
+    reserved.store(0);
+  }
+  MPI_Win_sync(log_win);
+  MPI_Barrier(node_comm);
+  if (0 != node_rank) {
+    return;
+  }
+
+  if (node_sink) {
+    node_sink->write(batch);
+    node_sink->flush();
+    return;
+  }
+
+  // one message per node leader reaches rank zero
+  const std::string packed = pack_batch(batch, options.log_compress);
+  int bytes = static_cast<int>(packed.size());
+  int leaders = 0;
+  MPI_Comm_size(leader_comm, &leaders);
+  std::vector<int> counts(0 == rank ? leaders : 0);
+  MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, leader_comm);
+  std::vector<int> displs(counts.size());
+  std::string gathered;
+  if (0 == rank) {
+    std::exclusive_scan(counts.begin(), counts.end(), displs.begin(), 0);
+    gathered.resize(displs.back() + counts.back());
+  }
+  MPI_Gatherv(packed.data(), bytes, MPI_CHAR, gathered.data(), counts.data(),
+              displs.data(), MPI_CHAR, 0, leader_comm);
+  if (0 == rank) {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+      emit(unpack_batch(
+          std::string_view(gathered).substr(displs[i], counts[i])));
+    }
+    std::fflush(stdout);
+  }
+}
+
+void MPIManager::emit(const std::string &text) {
+  std::lock_guard lock(output_mutex);
+  if (-1 == output_fd) {
+    std::fwrite(text.data(), 1, text.size(), stdout);
+    return;
+  }
+  // stdout is the capture pipe, so log output goes to the original descriptor
+  for (std::size_t written = 0; written < text.size();) {
+    const ssize_t bytes =
+        write(output_fd, text.data() + written, text.size() - written);
+    if (bytes < 0 && EINTR != errno) {
       break;
-    case Level::err:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_err(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_err(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
+    }
+    written += std::max<ssize_t>(bytes, 0);
+  }
+}
+
+void MPIManager::capture_init() {
+  std::fflush(stdout);
+  std::fflush(stderr);
+  int out[2];
+  int err[2];
+  if (0 != pipe2(out, O_CLOEXEC)) {
+    log_notice("Output capture is unavailable, stdout and stderr are not "
+               "captured.");
+    return;
+  }
+  if (0 != pipe2(err, O_CLOEXEC)) {
+    close(out[0]);
+    close(out[1]);
+    log_notice("Output capture is unavailable, stdout and stderr are not "
+               "captured.");
+    return;
+  }
+  // large pipes keep noisy libraries from blocking while lines are logged
+  fcntl(out[0], F_SETPIPE_SZ, static_cast<int>(options.capture_pipe_bytes));
+  fcntl(err[0], F_SETPIPE_SZ, static_cast<int>(options.capture_pipe_bytes));
+
+  output_fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+  error_fd = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 0);
+  dup2(out[1], STDOUT_FILENO);
+  dup2(err[1], STDERR_FILENO);
+  close(out[1]);
+  close(err[1]);
+  capture_thread = std::jthread(
+      [this, out = out[0], err = err[0]] { capture_drain(out, err); });
+}
+
+void MPIManager::capture_drain(const int out, const int err) {
+  constexpr Level levels[] = {Level::info, Level::warning};
+  constexpr const char *tags[] = {"external stdout", "external stderr"};
+  pollfd fds[] = {{out, POLLIN, 0}, {err, POLLIN, 0}};
+  std::string pending[2];
+  std::vector<char> buffer(1 << 16);
+
+  for (int open = 2; open > 0;) {
+    if (poll(fds, 2, -1) < 0) {
+      if (EINTR == errno) {
+        continue;
       }
       break;
-    case Level::warning:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_warning(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_warning(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
+    }
+    for (const auto i : {0, 1}) {
+      if (fds[i].fd < 0 || 0 == fds[i].revents) {
+        continue;
       }
-      break;
-    case Level::notice:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_notice(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_notice(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
+      const ssize_t bytes = read(fds[i].fd, buffer.data(), buffer.size());
+      if (bytes < 0 && EINTR == errno) {
+        continue;
       }
-      break;
-    case Level::info:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_info(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_info(msg);
-          }
-          MPI_Barrier(comm);
+      if (bytes <= 0) {
+        // the write end was restored, the last line may lack a newline
+        if (!pending[i].empty()) {
+          capture_line(levels[i], fmt::format("[{}] {}", tags[i], pending[i]));
         }
-        break;
+        close(fds[i].fd);
+        fds[i].fd = -1;
+        --open;
+        continue;
       }
-      break;
-    case Level::debug:
-      switch (ranks) {
-      case Ranks::zero:
-        if (0 == rank) {
-          log_debug(msg);
-        }
-        break;
-      case Ranks::all:
-        for (const auto i : std::views::iota(0, size)) {
-          if (rank == i) {
-            log_debug(msg);
-          }
-          MPI_Barrier(comm);
-        }
-        break;
+      pending[i].append(buffer.data(), bytes);
+      std::size_t begin = 0;
+      for (std::size_t end = pending[i].find('\n'); std::string::npos != end;
+           begin = end + 1, end = pending[i].find('\n', begin)) {
+        capture_line(levels[i],
+                     fmt::format("[{}] {}", tags[i],
+                                 std::string_view(pending[i])
+                                     .substr(begin, end - begin)));
       }
-      break;
+      pending[i].erase(0, begin);
     }
   }
 }
 
-void MPIManager::abort(const std::string &msg) {
-  log_emerg(msg);
-  MPI_Abort(comm, EXIT_FAILURE);
+void MPIManager::capture_line(const Level level, std::string msg) {
+  if (!sufficient_level(level)) {
+    return;
+  }
+  if (MPI_WIN_NULL != log_win) {
+    std::lock_guard lock(output_mutex);
+    captured.emplace_back(level, std::move(msg));
+    return;
+  }
+  log_local(level, msg);
+}
+
+void MPIManager::capture_stop() {
+  if (-1 == output_fd) {
+    return;
+  }
+  // restoring the descriptors closes the write ends, ending the drain
+  std::fflush(stdout);
+  std::fflush(stderr);
+  dup2(output_fd, STDOUT_FILENO);
+  dup2(error_fd, STDERR_FILENO);
+  capture_thread.join();
+  close(output_fd);
+  close(error_fd);
+  output_fd = -1;
+  error_fd = -1;
 }
 
 void MPIManager::log_emerg(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::dark_red), "[EMERG]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::emerg, msg);
 }
 
 void MPIManager::log_alert(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::red), "[ALERT]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::alert, msg);
 }
 
 void MPIManager::log_crit(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::dark_orange), "[CRIT]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::crit, msg);
 }
 
 void MPIManager::log_err(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::orange), "[ERR]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::err, msg);
 }
 
 void MPIManager::log_warning(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::orange), "[WARNING]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::warning, msg);
 }
 
 void MPIManager::log_notice(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::green), "[NOTICE]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::notice, msg);
 }
 
-
 void MPIManager::log_info(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::blue), "[INFO]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::info, msg);
 }
 
 void MPIManager::log_debug(const std::string &msg) {
-  fmt::print(fmt::emphasis::bold, "Rank {}: ", rank);
-  fmt::print(fg(fmt::color::purple), "[DEBUG]");
-  fmt::print(": {}\n", msg);
+  log_local(Level::debug, msg);
 }
 
 bool MPIManager::sufficient_level(const Level level) const {
@@ -227,32 +658,697 @@ bool MPIManager::sufficient_level(const Level level) const {
   return false;
 }
 
-bool MPIManager::sufficient_rank() const {
-  if (Ranks::zero == ranks) {
-    return 0 == rank;
-  }
-  return true;
-}
+bool MPIManager::sufficient_rank() const { return log_selected; }
 
 
 void MPIManager::timer_start(Level level, const std::string &name) {
+  // timers are kept on every rank so statistics can be reduced across ranks
+  timers.emplace_back(std::chrono::high_resolution_clock::now(), level, name,
+                      options.usage ? usage_now() : Usage{},
+                      energy_domains.empty() ? std::vector<std::uint64_t>{}
+                                             : energy_now());
+  if (nullptr != io_hooks) {
+    io_hooks->region_push(name.c_str());
+  }
+  if (sampler.joinable()) {
+    std::lock_guard lock(sampler_mutex);
+    sampler_region = name;
+  }
   if (sufficient_rank() && sufficient_level(level)) {
-    timers.emplace_back(std::chrono::high_resolution_clock::now(), level, name);
     log(level, "Timer: `" + name + "` started at: " + fmt::format(
                    fmt::runtime("{:%Y-%m-%d %H:%M:%S}"), timers.back().start));
   }
 }
 
 void MPIManager::timer_stop() {
-  if (sufficient_rank() && !timers.empty()) {
+  if (!timers.empty()) {
     const auto end = std::chrono::high_resolution_clock::now();
-    const auto [start, level, name] = timers.back();
+    const auto [start, level, name, usage, energy] = timers.back();
     const auto duration = end - start;
-    log(level,
-        "Timer: `" + name + "` stopped at: " + fmt::format(
-            fmt::runtime("{:%Y-%m-%d %H:%M:%S}"),
-            end) + " with duration: " + fmt::format(
-            fmt::runtime("{:%H:%M:%S}"), duration));
+
+    const double seconds = std::chrono::duration<double>(duration).count();
+    auto &[count, total, total_sq, min, max, total_usage, package_energy,
+           dram_energy] = stats[name];
+    ++count;
+    total += seconds;
+    total_sq += seconds * seconds;
+    min = std::min(min, seconds);
+    max = std::max(max, seconds);
+
+    std::string msg = "Timer: `" + name + "` stopped at: " +
+                      fmt::format(fmt::runtime("{:%Y-%m-%d %H:%M:%S}"), end) +
+                      " with duration: " +
+                      fmt::format(fmt::runtime("{:%H:%M:%S}"), duration);
+
+    if (options.usage) {
+      const auto now = usage_now();
+      const Usage delta{now.minor_faults - usage.minor_faults,
+                        now.major_faults - usage.major_faults,
+                        now.voluntary_switches - usage.voluntary_switches,
+                        now.involuntary_switches - usage.involuntary_switches,
+                        now.read_bytes - usage.read_bytes,
+                        now.write_bytes - usage.write_bytes};
+      total_usage.minor_faults += delta.minor_faults;
+      total_usage.major_faults += delta.major_faults;
+      total_usage.voluntary_switches += delta.voluntary_switches;
+      total_usage.involuntary_switches += delta.involuntary_switches;
+      total_usage.read_bytes += delta.read_bytes;
+      total_usage.write_bytes += delta.write_bytes;
+      msg += fmt::format(", page faults minor/major: {}/{}, context switches "
+                         "voluntary/involuntary: {}/{}, bytes read/written: "
+                         "{}/{}",
+                         delta.minor_faults, delta.major_faults,
+                         delta.voluntary_switches, delta.involuntary_switches,
+                         delta.read_bytes, delta.write_bytes);
+    }
+
+    if (!energy_domains.empty()) {
+      const auto now = energy_now();
+      double package = 0.0;
+      double dram = 0.0;
+      for (std::size_t i = 0; i < energy_domains.size(); ++i) {
+        (energy_domains[i].dram ? dram : package) +=
+            1e-6 * static_cast<double>(now[i] - energy[i]);
+      }
+      package_energy += package;
+      dram_energy += dram;
+      msg += fmt::format(", node energy package/DRAM: {:.3f}/{:.3f} J",
+                         package, dram);
+    }
+
     timers.pop_back();
+    if (nullptr != io_hooks) {
+      io_hooks->region_pop();
+    }
+    if (sampler.joinable()) {
+      std::lock_guard lock(sampler_mutex);
+      sampler_region = timers.empty() ? std::string{} : timers.back().name;
+    }
+    if (sufficient_rank()) {
+      log(level, msg);
+    }
+  }
+}
+
+void MPIManager::timer_report() {
+  std::vector<std::string> local;
+  for (const auto &name : stats | std::views::keys) {
+    local.push_back(name);
+  }
+  const auto names = union_names(local);
+  if (names.empty()) {
+    return;
+  }
+
+  // per timer: participating ranks, calls, total time, usage counters, node
+  // energy, average node power, then node frequency and temperature
+  constexpr std::size_t fields = 17;
+  std::vector<double> values(fields * names.size(), 0.0);
+  std::unique_lock lock(sampler_mutex);
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (const auto it = stats.find(names[i]); it != stats.end()) {
+      const auto &[count, total, total_sq, min, max, usage, package_energy,
+                   dram_energy] = it->second;
+      const double row[fields] = {1.0,
+                                  static_cast<double>(count),
+                                  total,
+                                  static_cast<double>(usage.minor_faults),
+                                  static_cast<double>(usage.major_faults),
+                                  static_cast<double>(usage.voluntary_switches),
+                                  static_cast<double>(usage.involuntary_switches),
+                                  static_cast<double>(usage.read_bytes),
+                                  static_cast<double>(usage.write_bytes),
+                                  package_energy,
+                                  dram_energy,
+                                  total > 0.0 ? package_energy / total : 0.0,
+                                  total > 0.0 ? dram_energy / total : 0.0,
+                                  0.0,
+                                  0.0,
+                                  std::numeric_limits<double>::infinity(),
+                                  0.0};
+      std::ranges::copy(row, values.begin() + fields * i);
+    }
+    if (const auto it = frequency_stats.find(names[i]);
+        it != frequency_stats.end()) {
+      const auto &[samples, frequency, frequency_min, temperature_max] =
+          it->second;
+      values[fields * i + 13] = 1.0;
+      values[fields * i + 14] = frequency / static_cast<double>(samples);
+      values[fields * i + 15] = frequency_min;
+      values[fields * i + 16] = temperature_max;
+    }
+  }
+  lock.unlock();
+
+  // ranks without a timer must not pull the minimum to zero
+  std::vector<double> min_in = values;
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    if (0.0 == values[fields * i]) {
+      std::fill_n(min_in.begin() + fields * i, fields,
+                  std::numeric_limits<double>::infinity());
+    }
+  }
+
+  const int n = static_cast<int>(values.size());
+  std::vector<double> sum(values.size()), min(values.size()),
+      max(values.size());
+  MPI_Reduce(values.data(), sum.data(), n, MPI_DOUBLE, MPI_SUM, 0, comm);
+  MPI_Reduce(min_in.data(), min.data(), n, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(values.data(), max.data(), n, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+  if (0 != rank || !sufficient_level(Level::info)) {
+    return;
+  }
+
+  for (std::size_t i = 0; i < names.size(); ++i) {
+    const auto at = [&](const std::vector<double> &v, const std::size_t j) {
+      return v[fields * i + j];
+    };
+    const double participants = at(sum, 0);
+    log_info(fmt::format("Timer report: `{}` ranks: {}, calls: {}, duration "
+                         "min/avg/max: {:.6f}/{:.6f}/{:.6f} s",
+                         names[i], participants, at(sum, 1), at(min, 2),
+                         at(sum, 2) / participants, at(max, 2)));
+    if (options.usage) {
+      log_info(fmt::format(
+          "Timer report: `{}` page faults minor/major: {}/{} (rank max "
+          "{}/{}), context switches voluntary/involuntary: {}/{} (rank max "
+          "{}/{}), bytes read/written: {}/{} (rank max {}/{})",
+          names[i], at(sum, 3), at(sum, 4), at(max, 3), at(max, 4),
+          at(sum, 5), at(sum, 6), at(max, 5), at(max, 6), at(sum, 7),
+          at(sum, 8), at(max, 7), at(max, 8)));
+    }
+    if (energy_available) {
+      log_info(fmt::format(
+          "Timer report: `{}` energy package/DRAM: {:.3f}/{:.3f} J, average "
+          "power package/DRAM: {:.3f}/{:.3f} W",
+          names[i], at(sum, 9), at(sum, 10), at(sum, 11), at(sum, 12)));
+    }
+    if (frequency_available && at(sum, 13) > 0.0) {
+      log_info(fmt::format(
+          "Timer report: `{}` CPU frequency node avg/min core: {:.0f}/{:.0f} "
+          "MHz, max temperature: {:.1f} C",
+          names[i], at(sum, 14) / at(sum, 13), at(min, 15), at(max, 16)));
+    }
+  }
+}
+
+void MPIManager::io_report() {
+  std::vector<IORecord> records;
+  if (nullptr != io_hooks) {
+    io_hooks->snapshot(records);
   }
-}
\ No newline at end of file
+
+  // files are aggregated by region before anything is exchanged, so the
+  // report stays independent of the number of files per rank
+  std::map<std::string, IOCounters> local_regions;
+  for (const auto &[region, path, c] : records) {
+    auto &r = local_regions[region];
+    r.opens += c.opens;
+    r.reads += c.reads;
+    r.writes += c.writes;
+    r.syncs += c.syncs;
+    r.stats += c.stats;
+    r.read_bytes += c.read_bytes;
+    r.write_bytes += c.write_bytes;
+    r.sequential += c.sequential;
+    r.random += c.random;
+    for (std::size_t j = 0; j < io_histogram_bins; ++j) {
+      r.histogram[j] += c.histogram[j];
+    }
+    r.read_time += c.read_time;
+    r.write_time += c.write_time;
+    r.meta_time += c.meta_time;
+  }
+  std::vector<std::string> local;
+  for (const auto &[region, c] : local_regions) {
+    local.push_back(region);
+  }
+  const auto keys = union_names(local);
+  if (keys.empty()) {
+    return;
+  }
+
+  constexpr std::size_t counts = 9 + io_histogram_bins;
+  constexpr std::size_t times = 3;
+  std::vector<std::uint64_t> local_counts(counts * keys.size(), 0);
+  std::vector<double> local_times(times * keys.size(), 0.0);
+  for (const auto &[region, c] : local_regions) {
+    const auto i = static_cast<std::size_t>(
+        std::ranges::lower_bound(keys, region) - keys.begin());
+    const std::uint64_t row[9] = {c.opens,      c.reads,       c.writes,
+                                  c.syncs,      c.stats,       c.read_bytes,
+                                  c.write_bytes, c.sequential, c.random};
+    std::ranges::copy(row, local_counts.begin() + counts * i);
+    std::ranges::copy(c.histogram, local_counts.begin() + counts * i + 9);
+    local_times[times * i] = c.read_time;
+    local_times[times * i + 1] = c.write_time;
+    local_times[times * i + 2] = c.meta_time;
+  }
+
+  std::vector<std::uint64_t> global_counts(local_counts.size());
+  std::vector<double> global_times(local_times.size());
+  MPI_Reduce(local_counts.data(), global_counts.data(),
+             static_cast<int>(local_counts.size()), MPI_UINT64_T, MPI_SUM, 0,
+             comm);
+  MPI_Reduce(local_times.data(), global_times.data(),
+             static_cast<int>(local_times.size()), MPI_DOUBLE, MPI_SUM, 0,
+             comm);
+
+  if (0 != rank) {
+    return;
+  }
+
+  std::map<std::string, IOCounters> regions;
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    auto &c = regions[keys[i]];
+    const auto *row = global_counts.data() + counts * i;
+    c.opens = row[0];
+    c.reads = row[1];
+    c.writes = row[2];
+    c.syncs = row[3];
+    c.stats = row[4];
+    c.read_bytes = row[5];
+    c.write_bytes = row[6];
+    c.sequential = row[7];
+    c.random = row[8];
+    std::copy_n(row + 9, io_histogram_bins, c.histogram);
+    c.read_time = global_times[times * i];
+    c.write_time = global_times[times * i + 1];
+    c.meta_time = global_times[times * i + 2];
+  }
+
+  for (const auto &[region, c] : regions) {
+    const auto name = region.empty() ? std::string("<none>") : region;
+    const auto data = c.reads + c.writes;
+    const auto meta = c.opens + c.stats + c.syncs;
+    std::uint64_t small = 0;
+    for (std::size_t j = 0; 256ull << (2 * j) <= io_small_access; ++j) {
+      small += c.histogram[j];
+    }
+
+    if (sufficient_level(Level::info)) {
+      log_info(fmt::format(
+          "I/O report: `{}` opens/stats/syncs: {}/{}/{}, reads/writes: {}/{}, "
+          "bytes read/written: {}/{}, sequential/random: {}/{}, time "
+          "read/write/metadata: {:.6f}/{:.6f}/{:.6f} s, access sizes: {}",
+          name, c.opens, c.stats, c.syncs, c.reads, c.writes, c.read_bytes,
+          c.write_bytes, c.sequential, c.random, c.read_time, c.write_time,
+          c.meta_time, fmt::join(c.histogram, "/")));
+    }
+    if (sufficient_level(Level::warning)) {
+      if (data >= io_storm_ops && 2 * small > data) {
+        log_warning(fmt::format("I/O report: `{}` small I/O, {} of {} "
+                                "accesses are below {} bytes",
+                                name, small, data, io_small_access));
+      }
+      if (meta >= io_storm_ops && meta > data) {
+        log_warning(fmt::format("I/O report: `{}` metadata storm, {} metadata "
+                                "operations against {} accesses",
+                                name, meta, data));
+      }
+    }
+  }
+}
+
+ThreadPool &MPIManager::pool() {
+  if (nullptr == thread_pool) {
+    thread_pool = std::make_unique<ThreadPool>(
+        0 == options.threads ? std::nullopt
+                             : std::optional<std::size_t>(options.threads));
+  }
+  return *thread_pool;
+}
+
+void MPIManager::pool_report() {
+  std::vector<ThreadTimes> times;
+  if (nullptr != thread_pool) {
+    times = thread_pool->times();
+  }
+
+  // workers, total busy and idle time, then least and most busy worker
+  double local[5] = {static_cast<double>(times.size()), 0.0, 0.0,
+                     std::numeric_limits<double>::infinity(), 0.0};
+  for (const auto &[busy, idle] : times) {
+    local[1] += busy;
+    local[2] += idle;
+    local[3] = std::min(local[3], busy);
+    local[4] = std::max(local[4], busy);
+  }
+
+  double sum[3] = {};
+  double min = 0.0;
+  double max = 0.0;
+  MPI_Reduce(local, sum, 3, MPI_DOUBLE, MPI_SUM, 0, comm);
+  MPI_Reduce(&local[3], &min, 1, MPI_DOUBLE, MPI_MIN, 0, comm);
+  MPI_Reduce(&local[4], &max, 1, MPI_DOUBLE, MPI_MAX, 0, comm);
+
+  if (0 == rank && sum[0] > 0.0 && sufficient_level(Level::info)) {
+    log_info(fmt::format("Thread report: {} workers, busy min/avg/max: "
+                         "{:.6f}/{:.6f}/{:.6f} s, idle avg: {:.6f} s, busy "
+                         "fraction: {:.1f}%",
+                         sum[0], min, sum[1] / sum[0], max, sum[2] / sum[0],
+                         100.0 * sum[1] / (sum[1] + sum[2])));
+  }
+}
+
+std::optional<TimerStats>
+MPIManager::timer_stats(const std::string &name) const {
+  if (const auto it = stats.find(name); it != stats.end()) {
+    return it->second;
+  }
+  return std::nullopt;
+}
+
+Usage MPIManager::usage_now() const {
+  Usage usage;
+
+  rusage ru{};
+  if (0 == getrusage(RUSAGE_THREAD, &ru)) {
+    usage.minor_faults = ru.ru_minflt;
+    usage.major_faults = ru.ru_majflt;
+    usage.voluntary_switches = ru.ru_nvcsw;
+    usage.involuntary_switches = ru.ru_nivcsw;
+  }
+
+  if (-1 != io_fd) {
+    char buffer[512];
+    const auto bytes = pread(io_fd, buffer, sizeof(buffer) - 1, 0);
+    if (bytes > 0) {
+      buffer[bytes] = '\0';
+      if (const char *rchar = std::strstr(buffer, "rchar:")) {
+        usage.read_bytes = std::strtoll(rchar + 6, nullptr, 10);
+      }
+      if (const char *wchar = std::strstr(buffer, "wchar:")) {
+        usage.write_bytes = std::strtoll(wchar + 6, nullptr, 10);
+      }
+    }
+  }
+
+  return usage;
+}
+
+void MPIManager::energy_init() {
+  namespace fs = std::filesystem;
+
+  // one reader per node covers every socket's package and DRAM domains
+  if (0 == node_rank) {
+    std::error_code ec;
+    for (const auto &entry :
+         fs::directory_iterator("/sys/class/powercap", ec)) {
+      const auto zone = entry.path().filename().string();
+      if (!zone.starts_with("intel-rapl:") && !zone.starts_with("amd-rapl:")) {
+        continue;
+      }
+
+      std::string name;
+      std::uint64_t range = 0;
+      std::ifstream(entry.path() / "name") >> name;
+      std::ifstream(entry.path() / "max_energy_range_uj") >> range;
+      if (!name.starts_with("package") && "dram" != name) {
+        continue;
+      }
+
+      EnergyDomain domain{entry.path() / "energy_uj", "dram" == name, range};
+      std::uint64_t value = 0;
+      if (std::ifstream(domain.path) >> value && 0 != range) {
+        domain.last = value;
+        energy_domains.push_back(domain);
+      }
+    }
+  }
+
+  int available = energy_domains.empty() ? 0 : 1;
+  MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_MAX, comm);
+  energy_available = 1 == available;
+  if (!energy_available && 0 == rank && sufficient_level(Level::notice)) {
+    log_notice("RAPL energy counters are unavailable, energy accounting is "
+               "disabled.");
+  }
+}
+
+std::vector<std::uint64_t> MPIManager::energy_now() {
+  // the sampler thread reads the counters between timers as well
+  std::lock_guard lock(energy_mutex);
+  std::vector<std::uint64_t> energy(energy_domains.size());
+  for (std::size_t i = 0; i < energy_domains.size(); ++i) {
+    auto &[path, dram, range, last, total] = energy_domains[i];
+    std::uint64_t value = last;
+    std::ifstream(path) >> value;
+    // counters wrap at range, at most once between samples
+    total += value >= last ? value - last : range - last + value;
+    last = value;
+    energy[i] = total;
+  }
+  return energy;
+}
+
+void MPIManager::frequency_init() {
+  namespace fs = std::filesystem;
+
+  if (0 == node_rank) {
+    std::error_code ec;
+    for (const auto &entry :
+         fs::directory_iterator("/sys/devices/system/cpu", ec)) {
+      const auto cpu = entry.path().filename().string();
+      const auto path = entry.path() / "cpufreq" / "scaling_cur_freq";
+      if (cpu.starts_with("cpu") && cpu.size() > 3 &&
+          std::isdigit(static_cast<unsigned char>(cpu[3])) &&
+          std::ifstream(path).good()) {
+        frequency_paths.push_back(path);
+      }
+    }
+    for (const auto &entry : fs::directory_iterator("/sys/class/thermal", ec)) {
+      const auto path = entry.path() / "temp";
+      if (entry.path().filename().string().starts_with("thermal_zone") &&
+          std::ifstream(path).good()) {
+        temperature_paths.push_back(path);
+      }
+    }
+  }
+
+  int available = frequency_paths.empty() ? 0 : 1;
+  MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_MAX, comm);
+  frequency_available = 1 == available;
+  if (!frequency_available && 0 == rank && sufficient_level(Level::notice)) {
+    log_notice("CPU frequency is unavailable, frequency sampling is "
+               "disabled.");
+  }
+}
+
+void MPIManager::sampler_init() {
+  using seconds = std::chrono::duration<double>;
+  const seconds frequency_interval(
+      frequency_paths.empty() ? 0.0 : options.frequency_interval);
+
+  // counters are read at least twice per wrap at the assumed peak power, so
+  // regions longer than a wrap still see every wraparound
+  double range = 0.0;
+  for (const auto &domain : energy_domains) {
+    range = 0.0 == range ? static_cast<double>(domain.range)
+                         : std::min(range, static_cast<double>(domain.range));
+  }
+  const seconds energy_interval(
+      0.0 == range ? 0.0
+                   : std::clamp(1e-6 * range / (2.0 * energy_peak_watts),
+                                energy_interval_min, energy_interval_max));
+  if (frequency_interval.count() <= 0.0 && energy_interval.count() <= 0.0) {
+    return;
+  }
+
+  sampler = std::jthread([this, frequency_interval,
+                          energy_interval](const std::stop_token &token) {
+    const auto start = std::chrono::steady_clock::now();
+    auto frequency_due = start + std::chrono::duration_cast<
+                                     std::chrono::steady_clock::duration>(
+                                     frequency_interval);
+    auto energy_due = start + std::chrono::duration_cast<
+                                  std::chrono::steady_clock::duration>(
+                                  energy_interval);
+    std::unique_lock lock(sampler_mutex);
+    while (true) {
+      auto due = frequency_interval.count() > 0.0 ? frequency_due : energy_due;
+      if (energy_interval.count() > 0.0) {
+        due = std::min(due, energy_due);
+      }
+      sampler_cv.wait_until(lock, token, due, [] { return false; });
+      if (token.stop_requested()) {
+        break;
+      }
+
+      lock.unlock();
+      const auto now = std::chrono::steady_clock::now();
+      if (frequency_interval.count() > 0.0 && now >= frequency_due) {
+        frequency_sample();
+        frequency_due += std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(frequency_interval);
+      }
+      if (energy_interval.count() > 0.0 && now >= energy_due) {
+        energy_now();
+        energy_due += std::chrono::duration_cast<
+            std::chrono::steady_clock::duration>(energy_interval);
+      }
+      lock.lock();
+    }
+  });
+}
+
+void MPIManager::frequency_sample() {
+  // files are read outside the lock so timers are never delayed by sysfs
+  double sum = 0.0;
+  double min = std::numeric_limits<double>::infinity();
+  std::size_t count = 0;
+  for (const auto &path : frequency_paths) {
+    double khz = 0.0;
+    if (std::ifstream(path) >> khz) {
+      sum += 1e-3 * khz;
+      min = std::min(min, 1e-3 * khz);
+      ++count;
+    }
+  }
+  double temperature = 0.0;
+  for (const auto &path : temperature_paths) {
+    double millidegrees = 0.0;
+    if (std::ifstream(path) >> millidegrees) {
+      temperature = std::max(temperature, 1e-3 * millidegrees);
+    }
+  }
+  if (0 == count) {
+    return;
+  }
+
+  const double frequency = sum / static_cast<double>(count);
+  std::lock_guard lock(sampler_mutex);
+  for (auto *stats : {&frequency_total, sampler_region.empty()
+                                            ? nullptr
+                                            : &frequency_stats[sampler_region]}) {
+    if (nullptr != stats) {
+      ++stats->samples;
+      stats->frequency += frequency;
+      stats->frequency_min = std::min(stats->frequency_min, min);
+      stats->temperature_max = std::max(stats->temperature_max, temperature);
+    }
+  }
+}
+
+void MPIManager::frequency_report() {
+  if (!frequency_available) {
+    return;
+  }
+
+  // non-leaders and leaders without samples send a negative frequency
+  double frequency = -1.0;
+  double temperature = 0.0;
+  if (frequency_total.samples > 0) {
+    frequency = frequency_total.frequency /
+                static_cast<double>(frequency_total.samples);
+    temperature = frequency_total.temperature_max;
+  }
+  char host[MPI_MAX_PROCESSOR_NAME] = {};
+  int length = 0;
+  MPI_Get_processor_name(host, &length);
+
+  std::vector<double> frequencies(0 == rank ? size : 0);
+  std::vector<double> temperatures(frequencies.size());
+  std::vector<char> hosts(frequencies.size() * MPI_MAX_PROCESSOR_NAME);
+  MPI_Gather(&frequency, 1, MPI_DOUBLE, frequencies.data(), 1, MPI_DOUBLE, 0,
+             comm);
+  MPI_Gather(&temperature, 1, MPI_DOUBLE, temperatures.data(), 1, MPI_DOUBLE,
+             0, comm);
+  MPI_Gather(host, MPI_MAX_PROCESSOR_NAME, MPI_CHAR, hosts.data(),
+             MPI_MAX_PROCESSOR_NAME, MPI_CHAR, 0, comm);
+
+  if (0 != rank) {
+    return;
+  }
+
+  std::vector<double> sampled;
+  for (const double f : frequencies) {
+    if (f >= 0.0) {
+      sampled.push_back(f);
+    }
+  }
+  if (sampled.empty()) {
+    return;
+  }
+  std::ranges::sort(sampled);
+  const auto n = sampled.size();
+  const double median = 0 == n % 2
+                            ? 0.5 * (sampled[n / 2 - 1] + sampled[n / 2])
+                            : sampled[n / 2];
+
+  if (sufficient_level(Level::info)) {
+    log_info(fmt::format("Frequency report: {} nodes, CPU frequency "
+                         "min/median/max: {:.0f}/{:.0f}/{:.0f} MHz",
+                         n, sampled.front(), median, sampled.back()));
+  }
+  for (int i = 0; i < size; ++i) {
+    if (frequencies[i] >= 0.0 &&
+        frequencies[i] < options.frequency_ratio * median &&
+        sufficient_level(Level::warning)) {
+      log_warning(fmt::format(
+          "Frequency report: node `{}` (leader rank {}) averaged {:.0f} MHz "
+          "against a fleet median of {:.0f} MHz at up to {:.1f} C, timings "
+          "on this node are likely throttled",
+          &hosts[i * MPI_MAX_PROCESSOR_NAME], i, frequencies[i], median,
+          temperatures[i]));
+    }
+  }
+}
+
+std::vector<std::string>
+MPIManager::union_names(const std::vector<std::string> &local) const {
+  // pack names as null terminated strings
+  std::string packed;
+  for (const auto &name : local) {
+    packed += name;
+    packed.push_back('\0');
+  }
+
+  int bytes = static_cast<int>(packed.size());
+  std::vector<int> counts(0 == rank ? size : 0);
+  MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+
+  std::vector<int> displs(counts.size());
+  std::string gathered;
+  if (0 == rank) {
+    for (int i = 0, offset = 0; i < size; ++i) {
+      displs[i] = offset;
+      offset += counts[i];
+    }
+    gathered.resize(displs.back() + counts.back());
+  }
+  MPI_Gatherv(packed.data(), bytes, MPI_CHAR, gathered.data(), counts.data(),
+              displs.data(), MPI_CHAR, 0, comm);
+
+  // deduplicate on rank zero and broadcast the union
+  if (0 == rank) {
+    std::vector<std::string> names;
+    for (std::size_t begin = 0; begin < gathered.size();) {
+      const auto end = gathered.find('\0', begin);
+      names.emplace_back(gathered, begin, end - begin);
+      begin = end + 1;
+    }
+    std::ranges::sort(names);
+    const auto [first, last] = std::ranges::unique(names);
+    names.erase(first, last);
+
+    packed.clear();
+    for (const auto &name : names) {
+      packed += name;
+      packed.push_back('\0');
+    }
+    bytes = static_cast<int>(packed.size());
+  }
+  MPI_Bcast(&bytes, 1, MPI_INT, 0, comm);
+  packed.resize(bytes);
+  MPI_Bcast(packed.data(), bytes, MPI_CHAR, 0, comm);
+
+  std::vector<std::string> names;
+  for (std::size_t begin = 0; begin < packed.size();) {
+    const auto end = packed.find('\0', begin);
+    names.emplace_back(packed, begin, end - begin);
+    begin = end + 1;
+  }
+  return names;
+}
@@ -0,0 +1,411 @@
+#include "mpimgr_array.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <numeric>
+
+namespace {
+/// magic number at the start and the end of an array file
+constexpr char magic[8] = {'M', 'P', 'I', 'M', 'G', 'R', 'A', '1'};
+
+/// bytes of the tail holding the footer offset and the magic number
+constexpr std::size_t tail_size = sizeof(std::uint64_t) + sizeof(magic);
+
+/// bytes per MPI-IO call, keeping counts within int
+constexpr std::uint64_t io_piece = std::uint64_t{1} << 30;
+
+/*!
+ * appends a value to a footer
+ * @tparam T value type
+ * @param out footer
+ * @param value value
+ */
+template <class T> void put(std::string &out, const T &value) {
+  out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+/*!
+ * reads a value from a footer
+ * @tparam T value type
+ * @param in remaining footer, advanced past the value
+ * @param value value read
+ * @return boolean stating if the footer held the value
+ */
+template <class T> bool get(std::string_view &in, T &value) {
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  std::memcpy(&value, in.data(), sizeof(T));
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+/*!
+ * returns the number of elements of a box
+ * @param extent number of elements in every dimension
+ * @return product of the extents
+ */
+std::uint64_t volume(const std::vector<std::uint64_t> &extent) {
+  return std::accumulate(extent.begin(), extent.end(), std::uint64_t{1},
+                         std::multiplies<>());
+}
+
+/*!
+ * parses a footer index
+ * @param in footer
+ * @param index parsed datasets
+ * @return boolean stating if the footer was well formed
+ */
+bool parse(std::string_view in, std::map<std::string, ArrayInfo> &index) {
+  std::uint32_t datasets = 0;
+  if (!get(in, datasets)) {
+    return false;
+  }
+  for (std::uint32_t i = 0; i < datasets; ++i) {
+    std::uint32_t length = 0;
+    if (!get(in, length) || in.size() < length) {
+      return false;
+    }
+    std::string name(in.substr(0, length));
+    in.remove_prefix(length);
+
+    ArrayInfo info;
+    std::uint32_t dims = 0;
+    std::uint64_t chunks = 0;
+    if (!get(in, info.type) || !get(in, dims)) {
+      return false;
+    }
+    info.shape.resize(dims);
+    for (auto &n : info.shape) {
+      if (!get(in, n)) {
+        return false;
+      }
+    }
+    if (!get(in, chunks)) {
+      return false;
+    }
+    info.chunks.resize(chunks);
+    for (auto &chunk : info.chunks) {
+      chunk.origin.resize(dims);
+      chunk.extent.resize(dims);
+      for (auto &n : chunk.origin) {
+        if (!get(in, n)) {
+          return false;
+        }
+      }
+      for (auto &n : chunk.extent) {
+        if (!get(in, n)) {
+          return false;
+        }
+      }
+      if (!get(in, chunk.offset)) {
+        return false;
+      }
+    }
+    index.emplace(std::move(name), std::move(info));
+  }
+  return in.empty();
+}
+} // namespace
+
+std::size_t element_size(const ElementType type) {
+  switch (type) {
+  case ElementType::int8:
+  case ElementType::uint8:
+    return 1;
+  case ElementType::int16:
+  case ElementType::uint16:
+    return 2;
+  case ElementType::int32:
+  case ElementType::uint32:
+  case ElementType::float32:
+    return 4;
+  case ElementType::int64:
+  case ElementType::uint64:
+  case ElementType::float64:
+    return 8;
+  }
+  return 0;
+}
+
+ArrayWriter::ArrayWriter(MPIManager &mgr, const std::string &path,
+                         const std::size_t chunk_bytes)
+    : mgr(mgr), path(path), chunk_bytes(std::max<std::size_t>(chunk_bytes, 1)),
+      end(sizeof(magic)) {
+  if (MPI_SUCCESS != MPI_File_open(mgr.comm, path.c_str(),
+                                   MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                                   MPI_INFO_NULL, &fh)) {
+    mgr.abort(fmt::format("ArrayWriter: cannot create `{}`", path));
+  }
+  MPI_File_set_size(fh, 0);
+  if (0 == mgr.rank) {
+    MPI_File_write_at(fh, 0, magic, sizeof(magic), MPI_CHAR,
+                      MPI_STATUS_IGNORE);
+  }
+}
+
+ArrayWriter::~ArrayWriter() { close(); }
+
+void ArrayWriter::write_bytes(const std::string &name, const ElementType type,
+                              const std::vector<std::uint64_t> &shape,
+                              const std::vector<std::uint64_t> &origin,
+                              const std::vector<std::uint64_t> &extent,
+                              const void *data, const std::size_t bytes) {
+  const auto dims = shape.size();
+  const auto width = element_size(type);
+  if (0 == dims || origin.size() != dims || extent.size() != dims) {
+    mgr.abort(fmt::format("ArrayWriter: dataset `{}` of `{}` needs origin and "
+                          "extent matching its {} dimensions",
+                          name, path, dims));
+  }
+  const auto elements = volume(extent);
+  for (std::size_t d = 0; d < dims && elements > 0; ++d) {
+    if (origin[d] + extent[d] > shape[d]) {
+      mgr.abort(fmt::format("ArrayWriter: block of dataset `{}` of `{}` "
+                            "exceeds its shape in dimension {}",
+                            name, path, d));
+    }
+  }
+  if (elements * width != bytes) {
+    mgr.abort(fmt::format("ArrayWriter: block of dataset `{}` of `{}` holds "
+                          "{} bytes instead of {}",
+                          name, path, bytes, elements * width));
+  }
+  mgr.timer_start(Level::debug, "ArrayWriter write");
+
+  // one gather of the block sizes yields the exclusive scan, the total and
+  // the number of collective write calls every rank must make
+  std::uint64_t local = bytes;
+  std::vector<std::uint64_t> sizes(mgr.size);
+  MPI_Allgather(&local, 1, MPI_UINT64_T, sizes.data(), 1, MPI_UINT64_T,
+                mgr.comm);
+  const auto offset =
+      end + std::accumulate(sizes.begin(), sizes.begin() + mgr.rank,
+                            std::uint64_t{0});
+  const auto total = std::accumulate(sizes.begin(), sizes.end(),
+                                     std::uint64_t{0});
+  const auto largest = *std::ranges::max_element(sizes);
+  for (std::uint64_t done = 0; done < largest; done += io_piece) {
+    const auto count = done < local ? std::min(io_piece, local - done) : 0;
+    MPI_File_write_at_all(fh, static_cast<MPI_Offset>(offset + done),
+                          static_cast<const char *>(data) +
+                              std::min(done, local),
+                          static_cast<int>(count), MPI_BYTE,
+                          MPI_STATUS_IGNORE);
+  }
+
+  // slabs of the first dimension are contiguous in the block, so chunks need
+  // no packing
+  std::vector<std::uint64_t> records;
+  if (elements > 0) {
+    const auto slice = elements / extent[0] * width;
+    const auto rows = std::max<std::uint64_t>(chunk_bytes / slice, 1);
+    for (std::uint64_t row = 0; row < extent[0]; row += rows) {
+      records.push_back(origin[0] + row);
+      records.insert(records.end(), origin.begin() + 1, origin.end());
+      records.push_back(std::min(rows, extent[0] - row));
+      records.insert(records.end(), extent.begin() + 1, extent.end());
+      records.push_back(offset + row * slice);
+    }
+  }
+  int count = static_cast<int>(records.size());
+  std::vector<int> counts(0 == mgr.rank ? mgr.size : 0);
+  MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, mgr.comm);
+  std::vector<int> displs(counts.size());
+  std::vector<std::uint64_t> gathered;
+  if (0 == mgr.rank) {
+    for (int i = 0, at = 0; i < mgr.size; ++i) {
+      displs[i] = at;
+      at += counts[i];
+    }
+    gathered.resize(displs.back() + counts.back());
+  }
+  MPI_Gatherv(records.data(), count, MPI_UINT64_T, gathered.data(),
+              counts.data(), displs.data(), MPI_UINT64_T, 0, mgr.comm);
+
+  if (0 == mgr.rank) {
+    if (index.contains(name)) {
+      mgr.abort(fmt::format("ArrayWriter: dataset `{}` written twice to `{}`",
+                            name, path));
+    }
+    auto &info = index[name];
+    info.type = type;
+    info.shape = shape;
+    const auto stride = 2 * dims + 1;
+    for (std::size_t i = 0; i + stride <= gathered.size(); i += stride) {
+      const auto record = gathered.begin() + static_cast<std::ptrdiff_t>(i);
+      info.chunks.push_back({{record, record + dims},
+                             {record + dims, record + 2 * dims},
+                             record[2 * dims]});
+    }
+  }
+  end += total;
+  mgr.timer_stop();
+}
+
+void ArrayWriter::close() {
+  if (MPI_FILE_NULL == fh) {
+    return;
+  }
+  if (0 == mgr.rank) {
+    std::string footer;
+    put(footer, static_cast<std::uint32_t>(index.size()));
+    for (const auto &[name, info] : index) {
+      put(footer, static_cast<std::uint32_t>(name.size()));
+      footer += name;
+      put(footer, info.type);
+      put(footer, static_cast<std::uint32_t>(info.shape.size()));
+      for (const auto n : info.shape) {
+        put(footer, n);
+      }
+      put(footer, static_cast<std::uint64_t>(info.chunks.size()));
+      for (const auto &chunk : info.chunks) {
+        for (const auto n : chunk.origin) {
+          put(footer, n);
+        }
+        for (const auto n : chunk.extent) {
+          put(footer, n);
+        }
+        put(footer, chunk.offset);
+      }
+    }
+    put(footer, end);
+    footer.append(magic, sizeof(magic));
+    MPI_File_write_at(fh, static_cast<MPI_Offset>(end), footer.data(),
+                      static_cast<int>(footer.size()), MPI_CHAR,
+                      MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&fh);
+  index.clear();
+}
+
+ArrayReader::ArrayReader(MPIManager &mgr, const std::string &path)
+    : mgr(mgr), path(path) {
+  if (MPI_SUCCESS != MPI_File_open(mgr.comm, path.c_str(), MPI_MODE_RDONLY,
+                                   MPI_INFO_NULL, &fh)) {
+    mgr.abort(fmt::format("ArrayReader: cannot open `{}`", path));
+  }
+
+  std::string footer;
+  std::uint64_t footer_size = 0;
+  if (0 == mgr.rank) {
+    MPI_Offset size = 0;
+    MPI_File_get_size(fh, &size);
+    char head[sizeof(magic)] = {};
+    char tail[tail_size] = {};
+    std::uint64_t footer_offset = 0;
+    if (static_cast<std::uint64_t>(size) >= sizeof(magic) + tail_size) {
+      MPI_File_read_at(fh, 0, head, sizeof(head), MPI_CHAR,
+                       MPI_STATUS_IGNORE);
+      MPI_File_read_at(fh, size - static_cast<MPI_Offset>(tail_size), tail,
+                       sizeof(tail), MPI_CHAR, MPI_STATUS_IGNORE);
+      std::memcpy(&footer_offset, tail, sizeof(footer_offset));
+    }
+    const auto footer_end = static_cast<std::uint64_t>(size) - tail_size;
+    if (0 != std::memcmp(head, magic, sizeof(magic)) ||
+        0 != std::memcmp(tail + sizeof(footer_offset), magic, sizeof(magic)) ||
+        footer_offset < sizeof(magic) || footer_offset > footer_end) {
+      mgr.abort(fmt::format("ArrayReader: `{}` is not an array file", path));
+    }
+    footer_size = footer_end - footer_offset;
+    footer.resize(footer_size);
+    MPI_File_read_at(fh, static_cast<MPI_Offset>(footer_offset), footer.data(),
+                     static_cast<int>(footer_size), MPI_CHAR,
+                     MPI_STATUS_IGNORE);
+  }
+  MPI_Bcast(&footer_size, 1, MPI_UINT64_T, 0, mgr.comm);
+  footer.resize(footer_size);
+  MPI_Bcast(footer.data(), static_cast<int>(footer_size), MPI_CHAR, 0,
+            mgr.comm);
+  if (!parse(footer, index)) {
+    mgr.abort(fmt::format("ArrayReader: footer index of `{}` is corrupt",
+                          path));
+  }
+}
+
+ArrayReader::~ArrayReader() { MPI_File_close(&fh); }
+
+const std::map<std::string, ArrayInfo> &ArrayReader::datasets() const {
+  return index;
+}
+
+void ArrayReader::read_bytes(const std::string &name, const ElementType type,
+                             const std::vector<std::uint64_t> &origin,
+                             const std::vector<std::uint64_t> &extent,
+                             void *out, const std::size_t bytes) {
+  const auto it = index.find(name);
+  if (index.end() == it) {
+    mgr.abort(fmt::format("ArrayReader: `{}` has no dataset `{}`", path, name));
+  }
+  const auto &info = it->second;
+  const auto dims = info.shape.size();
+  const auto width = element_size(type);
+  if (type != info.type) {
+    mgr.abort(fmt::format("ArrayReader: dataset `{}` of `{}` is read with a "
+                          "different element type than it was written with",
+                          name, path));
+  }
+  if (origin.size() != dims || extent.size() != dims ||
+      volume(extent) * width != bytes) {
+    mgr.abort(fmt::format("ArrayReader: hyperslab of dataset `{}` of `{}` "
+                          "does not match its {} dimensions or the output "
+                          "size",
+                          name, path, dims));
+  }
+
+  std::vector<std::uint64_t> lo(dims), hi(dims), idx(dims);
+  std::vector<char> buffer;
+  for (const auto &chunk : info.chunks) {
+    bool overlaps = true;
+    for (std::size_t d = 0; d < dims; ++d) {
+      lo[d] = std::max(origin[d], chunk.origin[d]);
+      hi[d] = std::min(origin[d] + extent[d], chunk.origin[d] + chunk.extent[d]);
+      overlaps = overlaps && lo[d] < hi[d];
+    }
+    if (!overlaps) {
+      continue;
+    }
+
+    // only the slabs of the first dimension inside the hyperslab are read
+    const auto slice = volume(chunk.extent) / chunk.extent[0] * width;
+    const auto first = chunk.offset + (lo[0] - chunk.origin[0]) * slice;
+    buffer.resize((hi[0] - lo[0]) * slice);
+    for (std::uint64_t done = 0; done < buffer.size(); done += io_piece) {
+      MPI_File_read_at(
+          fh, static_cast<MPI_Offset>(first + done), buffer.data() + done,
+          static_cast<int>(std::min<std::uint64_t>(io_piece,
+                                                   buffer.size() - done)),
+          MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    // copy runs along the last dimension, walking the others like an odometer
+    const auto run = (hi[dims - 1] - lo[dims - 1]) * width;
+    idx = lo;
+    while (true) {
+      std::uint64_t src = 0;
+      std::uint64_t dst = 0;
+      for (std::size_t d = 0; d < dims; ++d) {
+        const auto base = 0 == d ? lo[0] : chunk.origin[d];
+        const auto src_extent = 0 == d ? hi[0] - lo[0] : chunk.extent[d];
+        src = src * src_extent + (idx[d] - base);
+        dst = dst * extent[d] + (idx[d] - origin[d]);
+      }
+      std::memcpy(static_cast<char *>(out) + dst * width,
+                  buffer.data() + src * width, run);
+
+      std::ptrdiff_t d = static_cast<std::ptrdiff_t>(dims) - 2;
+      for (; d >= 0; --d) {
+        if (++idx[d] < hi[d]) {
+          break;
+        }
+        idx[d] = lo[d];
+      }
+      if (d < 0) {
+        break;
+      }
+    }
+  }
+}
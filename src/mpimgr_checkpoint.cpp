@@ -0,0 +1,172 @@
+#include "mpimgr_checkpoint.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+namespace {
+/// MTBF assumed when neither configured nor observed, one day
+constexpr double default_mtbf = 86400.0;
+
+/// where the MTBF came from, indexed by the broadcast source code
+constexpr const char *mtbf_sources[] = {"configured", "MPIMANAGER_MTBF",
+                                        "observed", "default"};
+
+/*!
+ * returns the current time
+ * @return seconds since the epoch
+ */
+double wall_now() {
+  return std::chrono::duration<double>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/*!
+ * estimates the MTBF from a run history, a run that started without ending
+ * cleanly or stopping for its deadline before the next start counts as a
+ * failure, every run counts its time up to its last record so the time
+ * between jobs is never counted as uptime
+ * @param path history file
+ * @return MTBF in seconds, zero if no failure was recorded
+ */
+double observed_mtbf(const std::string &path) {
+  std::ifstream in(path);
+  std::vector<std::pair<std::string, double>> events;
+  std::string kind;
+  double time = 0.0;
+  while (in >> kind >> time) {
+    events.emplace_back(kind, time);
+  }
+
+  double total = 0.0;
+  int failures = 0;
+  for (std::size_t i = 0; i < events.size(); ++i) {
+    if ("start" != events[i].first) {
+      continue;
+    }
+    // the checkpoint, deadline and end records of this run precede the next
+    // start
+    bool failed = true;
+    std::size_t next = i + 1;
+    for (; next < events.size() && "start" != events[next].first; ++next) {
+      failed = failed && "end" != events[next].first &&
+               "deadline" != events[next].first;
+    }
+    total += std::max(0.0, events[next - 1].second - events[i].second);
+    failures += failed ? 1 : 0;
+  }
+  return failures > 0 ? total / failures : 0.0;
+}
+} // namespace
+
+CheckpointScheduler::CheckpointScheduler(MPIManager &mgr,
+                                         CheckpointOptions options)
+    : mgr(mgr), options(std::move(options)), mtbf(this->options.mtbf),
+      cost(this->options.cost), last(std::chrono::steady_clock::now()) {
+  // rank zero resolves the MTBF, the history only being read there
+  int source = 0;
+  if (0 == mgr.rank) {
+    if (mtbf <= 0.0) {
+      const char *env = std::getenv("MPIMANAGER_MTBF");
+      mtbf = nullptr != env ? std::atof(env) : 0.0;
+      source = 1;
+    }
+    if (mtbf <= 0.0 && !this->options.history.empty()) {
+      mtbf = observed_mtbf(this->options.history);
+      source = 2;
+    }
+    if (mtbf <= 0.0) {
+      mtbf = default_mtbf;
+      source = 3;
+    }
+    if (!this->options.history.empty()) {
+      std::ofstream(this->options.history, std::ios::app)
+          << fmt::format("start {:.3f}\n", wall_now());
+    }
+  }
+  MPI_Bcast(&mtbf, 1, MPI_DOUBLE, 0, mgr.comm);
+  MPI_Bcast(&source, 1, MPI_INT, 0, mgr.comm);
+  mtbf_source = mtbf_sources[source];
+
+  update();
+  mgr.log(Level::info,
+          fmt::format("Checkpoint: assumed cost: {:.3f} s, MTBF: {:.6g} s "
+                      "({}), interval: {:.6g} s",
+                      cost, mtbf, mtbf_source, period));
+}
+
+CheckpointScheduler::~CheckpointScheduler() {
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  if (0 == mgr.rank && !options.history.empty()) {
+    std::ofstream(options.history, std::ios::app)
+        << fmt::format("end {:.3f}\n", wall_now());
+  }
+}
+
+bool CheckpointScheduler::should_checkpoint() {
+  // the broadcast started at the previous step boundary has had a whole step
+  // to complete
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  const bool due = 0 != decision;
+
+  if (0 == mgr.rank) {
+    const auto now = std::chrono::steady_clock::now();
+    if (due) {
+      last = now;
+    }
+    const std::chrono::duration<double> elapsed = now - last;
+    decision = elapsed.count() >= period ? 1 : 0;
+  }
+  MPI_Ibcast(&decision, 1, MPI_INT, 0, mgr.comm, &request);
+  return due;
+}
+
+void CheckpointScheduler::checkpoint(const std::function<void()> &write) {
+  mgr.timer_start(Level::info, options.timer);
+  write();
+  mgr.timer_stop();
+  if (0 == mgr.rank && !options.history.empty()) {
+    std::ofstream(options.history, std::ios::app)
+        << fmt::format("checkpoint {:.3f}\n", wall_now());
+  }
+
+  const auto stats = mgr.timer_stats(options.timer);
+  cost = stats->total / static_cast<double>(stats->count);
+  MPI_Allreduce(MPI_IN_PLACE, &cost, 1, MPI_DOUBLE, MPI_MAX, mgr.comm);
+  last = std::chrono::steady_clock::now();
+
+  const double previous = period;
+  update();
+  if (std::abs(period - previous) > 0.01 * previous) {
+    mgr.log(Level::info,
+            fmt::format("Checkpoint: measured cost: {:.3f} s, MTBF: {:.6g} s "
+                        "({}), interval: {:.6g} s",
+                        cost, mtbf, mtbf_source, period));
+  }
+}
+
+void CheckpointScheduler::deadline_stop() {
+  if (0 == mgr.rank && !options.history.empty()) {
+    std::ofstream(options.history, std::ios::app)
+        << fmt::format("deadline {:.3f}\n", wall_now());
+  }
+}
+
+double CheckpointScheduler::interval() const { return period; }
+
+void CheckpointScheduler::update() {
+  if (cost >= 2.0 * mtbf) {
+    period = mtbf;
+    return;
+  }
+  // Daly's higher order estimate, Young's sqrt(2 C M) being its leading term
+  const double ratio = std::sqrt(cost / (2.0 * mtbf));
+  period = std::sqrt(2.0 * cost * mtbf) *
+               (1.0 + ratio / 3.0 + ratio * ratio / 9.0) -
+           cost;
+}
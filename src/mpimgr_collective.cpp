@@ -0,0 +1,85 @@
+#include "mpimgr_collective.h"
+
+PersistentCollective::PersistentCollective(
+    [[maybe_unused]] const std::function<void(MPI_Request *)> &init,
+    std::function<void(MPI_Request *)> launch) {
+#if MPIMANAGER_HAVE_PERSISTENT_COLLECTIVES
+  init(&request);
+#else
+  this->launch = std::move(launch);
+#endif
+}
+
+PersistentCollective::~PersistentCollective() {
+  if (active) {
+    wait();
+  }
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Request_free(&request);
+  }
+}
+
+void PersistentCollective::start() {
+  if (launch) {
+    launch(&request);
+  } else {
+    MPI_Start(&request);
+  }
+  active = true;
+}
+
+void PersistentCollective::wait() {
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  active = false;
+}
+
+bool PersistentCollective::test() {
+  int flag = 0;
+  MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+  active = 0 == flag;
+  return !active;
+}
+
+PersistentAllreduce::PersistentAllreduce(MPIManager &mgr, const void *sendbuf,
+                                         void *recvbuf, const int count,
+                                         const MPI_Datatype type,
+                                         const MPI_Op op)
+    : PersistentCollective(
+          [&]([[maybe_unused]] MPI_Request *request) {
+#if MPIMANAGER_HAVE_PERSISTENT_COLLECTIVES
+            MPI_Allreduce_init(sendbuf, recvbuf, count, type, op, mgr.comm,
+                               MPI_INFO_NULL, request);
+#endif
+          },
+          [=, comm = mgr.comm](MPI_Request *request) {
+            MPI_Iallreduce(sendbuf, recvbuf, count, type, op, comm, request);
+          }) {}
+
+PersistentReduce::PersistentReduce(MPIManager &mgr, const void *sendbuf,
+                                   void *recvbuf, const int count,
+                                   const MPI_Datatype type, const MPI_Op op,
+                                   const int root)
+    : PersistentCollective(
+          [&]([[maybe_unused]] MPI_Request *request) {
+#if MPIMANAGER_HAVE_PERSISTENT_COLLECTIVES
+            MPI_Reduce_init(sendbuf, recvbuf, count, type, op, root, mgr.comm,
+                            MPI_INFO_NULL, request);
+#endif
+          },
+          [=, comm = mgr.comm](MPI_Request *request) {
+            MPI_Ireduce(sendbuf, recvbuf, count, type, op, root, comm,
+                        request);
+          }) {}
+
+PersistentBcast::PersistentBcast(MPIManager &mgr, void *buf, const int count,
+                                 const MPI_Datatype type, const int root)
+    : PersistentCollective(
+          [&]([[maybe_unused]] MPI_Request *request) {
+#if MPIMANAGER_HAVE_PERSISTENT_COLLECTIVES
+            MPI_Bcast_init(buf, count, type, root, mgr.comm, MPI_INFO_NULL,
+                           request);
+#endif
+          },
+          [=, comm = mgr.comm](MPI_Request *request) {
+            MPI_Ibcast(buf, count, type, root, comm, request);
+          }) {}
@@ -0,0 +1,292 @@
+#include "mpimgr_csv.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <immintrin.h>
+#include <limits>
+#include <string_view>
+
+namespace {
+/// smallest byte range worth a rank, smaller files are read by fewer ranks
+constexpr std::uint64_t min_range = std::uint64_t{1} << 16;
+
+/// bytes per collective read call
+constexpr std::uint64_t read_chunk = std::uint64_t{1} << 30;
+
+/// bytes scanned for separators at a time, bounding the separator list
+constexpr std::size_t scan_block = std::size_t{1} << 16;
+
+/*!
+ * appends the positions of delimiters and newlines with AVX2, 32 bytes per
+ * comparison
+ * @param data text
+ * @param n number of bytes
+ * @param base position of data in the text
+ * @param delimiter field delimiter
+ * @param out separator positions
+ */
+__attribute__((target("avx2"))) void
+scan_avx2(const char *data, const std::size_t n, const std::size_t base,
+          const char delimiter, std::vector<std::size_t> &out) {
+  const __m256i vd = _mm256_set1_epi8(delimiter);
+  const __m256i vn = _mm256_set1_epi8('\n');
+  std::size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m256i chunk =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, vd),
+                        _mm256_cmpeq_epi8(chunk, vn))));
+    while (0 != mask) {
+      out.push_back(base + i + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+  for (; i < n; ++i) {
+    if (delimiter == data[i] || '\n' == data[i]) {
+      out.push_back(base + i);
+    }
+  }
+}
+
+/*!
+ * appends the positions of delimiters and newlines one byte at a time
+ * @param data text
+ * @param n number of bytes
+ * @param base position of data in the text
+ * @param delimiter field delimiter
+ * @param out separator positions
+ */
+void scan_scalar(const char *data, const std::size_t n, const std::size_t base,
+                 const char delimiter, std::vector<std::size_t> &out) {
+  for (std::size_t i = 0; i < n; ++i) {
+    if (delimiter == data[i] || '\n' == data[i]) {
+      out.push_back(base + i);
+    }
+  }
+}
+
+/// boolean stating if the CPU supports the AVX2 scanner
+const bool has_avx2 = __builtin_cpu_supports("avx2");
+
+/*!
+ * splits a line into fields
+ * @param line line without its newline
+ * @param delimiter field delimiter
+ * @return fields
+ */
+std::vector<std::string> split(std::string_view line, const char delimiter) {
+  if (line.ends_with('\r')) {
+    line.remove_suffix(1);
+  }
+  std::vector<std::string> fields;
+  while (true) {
+    const auto at = line.find(delimiter);
+    fields.emplace_back(line.substr(0, at));
+    if (std::string_view::npos == at) {
+      return fields;
+    }
+    line.remove_prefix(at + 1);
+  }
+}
+} // namespace
+
+CsvReader::CsvReader(MPIManager &mgr, const char delimiter, const bool header)
+    : mgr(mgr), delimiter(delimiter), header(header) {}
+
+CsvTable CsvReader::read(const std::string &path,
+                         const std::vector<ColumnType> &types) {
+  const auto before = mgr.timer_stats("CsvReader read");
+  mgr.timer_start(Level::debug, "CsvReader read");
+
+  MPI_File fh;
+  if (MPI_SUCCESS != MPI_File_open(mgr.comm, path.c_str(), MPI_MODE_RDONLY,
+                                   MPI_INFO_NULL, &fh)) {
+    mgr.abort(fmt::format("CsvReader: cannot open `{}`", path));
+  }
+  MPI_Offset file_size = 0;
+  MPI_File_get_size(fh, &file_size);
+  const auto size = static_cast<std::uint64_t>(file_size);
+
+  // ranks beyond the active ones read nothing so no range is tiny
+  const auto active = static_cast<int>(std::clamp<std::uint64_t>(
+      (size + min_range - 1) / min_range, 1, mgr.size));
+  const auto range_of = [&](const int r) {
+    return std::min<std::uint64_t>(
+        size, size * static_cast<std::uint64_t>(r) / active);
+  };
+  const auto begin = range_of(std::min(mgr.rank, active));
+  const auto end = range_of(std::min(mgr.rank + 1, active));
+
+  std::string text(end - begin, '\0');
+  const auto largest = (size + active - 1) / active;
+  for (std::uint64_t done = 0; done < largest; done += read_chunk) {
+    const auto count =
+        done < text.size() ? std::min(read_chunk, text.size() - done) : 0;
+    MPI_File_read_at_all(fh, static_cast<MPI_Offset>(begin + done),
+                         text.data() + std::min(done, text.size()),
+                         static_cast<int>(count), MPI_BYTE, MPI_STATUS_IGNORE);
+  }
+  MPI_File_close(&fh);
+
+  // the bytes before the first newline finish the last record of the left
+  // neighbour, one exchange hands them over
+  std::size_t prefix = 0;
+  if (mgr.rank > 0 && mgr.rank < active) {
+    const auto newline = text.find('\n');
+    if (std::string::npos == newline) {
+      mgr.abort(fmt::format("CsvReader: a record of `{}` spans more than the "
+                            "{} byte range of rank {}",
+                            path, text.size(), mgr.rank));
+    }
+    prefix = newline + 1;
+  }
+  const int left =
+      mgr.rank > 0 && mgr.rank < active ? mgr.rank - 1 : MPI_PROC_NULL;
+  const int right = mgr.rank + 1 < active ? mgr.rank + 1 : MPI_PROC_NULL;
+  std::uint64_t prefix_size = prefix;
+  std::uint64_t suffix_size = 0;
+  MPI_Sendrecv(&prefix_size, 1, MPI_UINT64_T, left, 0, &suffix_size, 1,
+               MPI_UINT64_T, right, 0, mgr.comm, MPI_STATUS_IGNORE);
+  text.resize(text.size() + suffix_size);
+  MPI_Sendrecv(text.data(), static_cast<int>(prefix), MPI_CHAR, left, 1,
+               text.data() + text.size() - suffix_size,
+               static_cast<int>(suffix_size), MPI_CHAR, right, 1, mgr.comm,
+               MPI_STATUS_IGNORE);
+  std::string_view data(text);
+  data.remove_prefix(prefix);
+
+  // rank zero owns the first line, which names the columns or at least
+  // tells how many there are
+  std::string first;
+  if (0 == mgr.rank) {
+    const auto newline = data.find('\n');
+    first = data.substr(0, newline);
+    if (header) {
+      data.remove_prefix(std::string_view::npos == newline ? data.size()
+                                                           : newline + 1);
+    }
+  }
+  auto first_size = static_cast<std::uint64_t>(first.size());
+  MPI_Bcast(&first_size, 1, MPI_UINT64_T, 0, mgr.comm);
+  first.resize(first_size);
+  MPI_Bcast(first.data(), static_cast<int>(first_size), MPI_CHAR, 0, mgr.comm);
+
+  CsvTable table;
+  const auto names = split(first, delimiter);
+  for (std::size_t c = 0; c < names.size(); ++c) {
+    table.columns.push_back(
+        {header ? names[c] : std::to_string(c),
+         c < types.size() ? types[c] : ColumnType::text,
+         {},
+         {},
+         {}});
+  }
+  const auto columns = table.columns.size();
+
+  const auto store = [&](const std::size_t c, std::string_view field) {
+    auto &column = table.columns[c];
+    const auto *first_char = field.data();
+    const auto *last_char = field.data() + field.size();
+    switch (column.type) {
+    case ColumnType::integer: {
+      std::int64_t value = 0;
+      if (!field.empty()) {
+        const auto [ptr, ec] = std::from_chars(first_char, last_char, value);
+        if (std::errc() != ec || last_char != ptr) {
+          mgr.abort(fmt::format("CsvReader: `{}` in column `{}` of `{}` is "
+                                "not an integer",
+                                field, column.name, path));
+        }
+      }
+      column.integers.push_back(value);
+      break;
+    }
+    case ColumnType::real: {
+      double value = std::numeric_limits<double>::quiet_NaN();
+      if (!field.empty()) {
+        const auto [ptr, ec] = std::from_chars(first_char, last_char, value);
+        if (std::errc() != ec || last_char != ptr) {
+          mgr.abort(fmt::format("CsvReader: `{}` in column `{}` of `{}` is "
+                                "not a number",
+                                field, column.name, path));
+        }
+      }
+      column.reals.push_back(value);
+      break;
+    }
+    case ColumnType::text:
+      column.texts.emplace_back(field);
+      break;
+    }
+  };
+
+  // fields end at separators found block by block, a record ends at a newline
+  // and missing trailing fields are stored empty
+  std::vector<std::size_t> separators;
+  separators.reserve(scan_block);
+  std::size_t field_start = 0;
+  std::size_t column = 0;
+  const auto end_field = [&](const std::size_t at, const bool end_of_record) {
+    auto field = data.substr(field_start, at - field_start);
+    if (end_of_record && field.ends_with('\r')) {
+      field.remove_suffix(1);
+    }
+    // lines holding nothing are skipped
+    if (end_of_record && 0 == column && field.empty()) {
+      field_start = at + 1;
+      return;
+    }
+    if (column < columns) {
+      store(column, field);
+    }
+    ++column;
+    if (end_of_record) {
+      for (; column < columns; ++column) {
+        store(column, {});
+      }
+      column = 0;
+      ++table.rows;
+    }
+    field_start = at + 1;
+  };
+  for (std::size_t block = 0; block < data.size(); block += scan_block) {
+    const auto n = std::min(scan_block, data.size() - block);
+    separators.clear();
+    if (has_avx2) {
+      scan_avx2(data.data() + block, n, block, delimiter, separators);
+    } else {
+      scan_scalar(data.data() + block, n, block, delimiter, separators);
+    }
+    for (const auto at : separators) {
+      end_field(at, '\n' == data[at]);
+    }
+  }
+  if (field_start < data.size() || column > 0) {
+    end_field(data.size(), true);
+  }
+
+  MPI_Exscan(&table.rows, &table.first_row, 1, MPI_UINT64_T, MPI_SUM,
+             mgr.comm);
+  if (0 == mgr.rank) {
+    table.first_row = 0;
+  }
+  mgr.timer_stop();
+
+  double seconds = mgr.timer_stats("CsvReader read")->total -
+                   (before ? before->total : 0.0);
+  std::uint64_t rows = table.rows;
+  MPI_Allreduce(MPI_IN_PLACE, &seconds, 1, MPI_DOUBLE, MPI_MAX, mgr.comm);
+  MPI_Allreduce(MPI_IN_PLACE, &rows, 1, MPI_UINT64_T, MPI_SUM, mgr.comm);
+  const auto mib = 1.0 / (1 << 20) * static_cast<double>(size);
+  mgr.log(Level::info,
+          fmt::format("CsvReader: {} rows ({:.1f} MiB) read from `{}` by {} "
+                      "ranks in {:.3f} s, {:.0f} rows/s ({:.1f} MiB/s)",
+                      rows, mib, path, active, seconds,
+                      seconds > 0.0 ? static_cast<double>(rows) / seconds : 0.0,
+                      seconds > 0.0 ? mib / seconds : 0.0));
+  return table;
+}
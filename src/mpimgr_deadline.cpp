@@ -0,0 +1,143 @@
+#include "mpimgr_deadline.h"
+
+#include <fmt/format.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+
+namespace {
+/*!
+ * parses a walltime given in seconds or as [[HH:]MM:]SS
+ * @param text walltime
+ * @return seconds, zero if the text is malformed
+ */
+double parse_walltime(const std::string &text) {
+  std::istringstream in(text);
+  double seconds = 0.0;
+  double part = 0.0;
+  int parts = 0;
+  while (in >> part) {
+    seconds = 60.0 * seconds + part;
+    ++parts;
+    if (':' != in.peek()) {
+      break;
+    }
+    in.get();
+  }
+  return parts > 0 && parts <= 3 && in.eof() ? seconds : 0.0;
+}
+
+/*!
+ * predicts a duration from timer statistics
+ * @param count number of samples
+ * @param total sum of the samples
+ * @param total_sq sum of the squared samples
+ * @param safety number of standard deviations added to the mean
+ * @return mean plus safety standard deviations
+ */
+double predict(const std::size_t count, const double total,
+               const double total_sq, const double safety) {
+  const double mean = total / static_cast<double>(count);
+  const double variance =
+      std::max(0.0, total_sq / static_cast<double>(count) - mean * mean);
+  return mean + safety * std::sqrt(variance);
+}
+} // namespace
+
+DeadlineManager::DeadlineManager(MPIManager &mgr, DeadlineOptions options)
+    : mgr(mgr), options(std::move(options)),
+      previous(std::chrono::steady_clock::now()) {
+  // rank zero resolves the deadline so every rank counts from the same value
+  double known[2] = {0.0, 0.0};
+  if (0 == mgr.rank) {
+    if (this->options.remaining > 0.0) {
+      known[0] = 1.0;
+      known[1] = this->options.remaining;
+    } else if (const char *env = std::getenv("MPIMANAGER_DEADLINE")) {
+      const auto now = std::chrono::duration<double>(
+          std::chrono::system_clock::now().time_since_epoch());
+      known[0] = 1.0;
+      known[1] = std::atof(env) - now.count();
+    } else if (const char *env = std::getenv("MPIMANAGER_WALLTIME")) {
+      known[1] = parse_walltime(env);
+      known[0] = known[1] > 0.0 ? 1.0 : 0.0;
+    }
+  }
+  MPI_Bcast(known, 2, MPI_DOUBLE, 0, mgr.comm);
+
+  enabled = 0.0 != known[0];
+  deadline = previous +
+             std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                 std::chrono::duration<double>(known[1]));
+  if (enabled) {
+    mgr.log(Level::info,
+            fmt::format("Deadline: {:.1f} s of walltime left", known[1]));
+  }
+}
+
+bool DeadlineManager::should_stop() {
+  if (!enabled) {
+    return false;
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  // the first call only marks the start of the first step
+  if (started) {
+    const std::chrono::duration<double> step = now - previous;
+    ++steps;
+    steps_total += step.count();
+    steps_total_sq += step.count() * step.count();
+  }
+  previous = now;
+  started = true;
+
+  // the slowest prediction and the least time left of any rank decide
+  double predicted[3] = {0.0, options.checkpoint_cost, -remaining()};
+  if (const auto stats = mgr.timer_stats(options.step_timer);
+      stats && stats->count > 0) {
+    predicted[0] = predict(stats->count, stats->total, stats->total_sq,
+                           options.safety);
+  } else if (steps > 0) {
+    predicted[0] = predict(steps, steps_total, steps_total_sq, options.safety);
+  }
+  if (const auto stats = mgr.timer_stats(options.checkpoint_timer);
+      stats && stats->count > 0) {
+    predicted[1] = predict(stats->count, stats->total, stats->total_sq,
+                           options.safety);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, predicted, 3, MPI_DOUBLE, MPI_MAX, mgr.comm);
+
+  const double left = -predicted[2];
+  if (left >= predicted[0] + predicted[1] + options.margin) {
+    return false;
+  }
+  mgr.log(Level::warning,
+          fmt::format("Deadline: stopping with {:.1f} s left, next step "
+                      "predicted: {:.3f} s, final checkpoint predicted: "
+                      "{:.3f} s, margin: {:.1f} s",
+                      left, predicted[0], predicted[1], options.margin));
+  return true;
+}
+
+void DeadlineManager::finish(const std::function<void()> &write) {
+  mgr.timer_start(Level::info, options.checkpoint_timer);
+  write();
+  mgr.timer_stop();
+
+  double left = remaining();
+  MPI_Allreduce(MPI_IN_PLACE, &left, 1, MPI_DOUBLE, MPI_MIN, mgr.comm);
+  mgr.log(Level::info,
+          fmt::format("Deadline: final checkpoint written with {:.1f} s left",
+                      left));
+}
+
+double DeadlineManager::remaining() const {
+  if (!enabled) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return std::chrono::duration<double>(deadline -
+                                       std::chrono::steady_clock::now())
+      .count();
+}
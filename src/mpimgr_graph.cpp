@@ -0,0 +1,216 @@
+#include "mpimgr_graph.h"
+#include "mpimgr_pool.h"
+
+#include <fmt/format.h>
+
+#include <fstream>
+#include <map>
+
+TaskGraph::TaskGraph(MPIManager &mgr, std::string name)
+    : mgr(mgr), name(std::move(name)) {}
+
+TaskId TaskGraph::compute(const std::string &name, std::function<void()> fn,
+                          const std::vector<TaskId> &deps) {
+  return add({.name = name, .kind = TaskKind::compute, .fn = std::move(fn)},
+             deps);
+}
+
+TaskId TaskGraph::communicate(
+    const std::string &name,
+    std::function<std::vector<MPI_Request>(MPI_Comm)> start,
+    const std::vector<TaskId> &deps) {
+  return add({.name = name,
+              .kind = TaskKind::communicate,
+              .start = std::move(start)},
+             deps);
+}
+
+TaskId TaskGraph::add(Node node, const std::vector<TaskId> &deps) {
+  const TaskId id = nodes.size();
+
+  // dependencies must already exist, which keeps the graph acyclic
+  for (const auto dep : deps) {
+    if (dep >= id) {
+      mgr.abort(fmt::format("TaskGraph `{}`: task `{}` depends on unknown "
+                            "task {}",
+                            name, node.name, dep));
+    }
+    nodes[dep].successors.push_back(id);
+  }
+  node.deps = deps.size();
+  nodes.push_back(std::move(node));
+  return id;
+}
+
+void TaskGraph::run(const Level level) {
+  mgr.timer_start(level, name);
+
+  TaskGroup compute_group;
+  pool = &mgr.pool();
+  group = &compute_group;
+  origin = std::chrono::steady_clock::now();
+  owner = std::this_thread::get_id();
+  finished.store(0);
+  remaining = std::make_unique<std::atomic<std::size_t>[]>(nodes.size());
+  for (TaskId id = 0; id < nodes.size(); ++id) {
+    remaining[id].store(nodes[id].deps);
+  }
+  for (TaskId id = 0; id < nodes.size(); ++id) {
+    if (0 == nodes[id].deps) {
+      ready(id);
+    }
+  }
+
+  // requests in flight and the communication task each belongs to
+  std::vector<MPI_Request> requests;
+  std::vector<TaskId> owners;
+  std::map<TaskId, std::size_t> outstanding;
+  std::vector<int> indices;
+  std::vector<TaskId> starting;
+
+  while (finished.load() < nodes.size()) {
+    {
+      std::lock_guard lock(ready_mutex);
+      starting.swap(ready_comms);
+    }
+    for (const auto id : starting) {
+      auto &node = nodes[id];
+      node.thread = owner;
+      node.begin_ns = elapsed();
+      const auto started = node.start(mgr.comm);
+      for (const auto request : started) {
+        requests.push_back(request);
+        owners.push_back(id);
+      }
+      outstanding[id] = started.size();
+      if (started.empty()) {
+        node.end_ns = elapsed();
+        outstanding.erase(id);
+        release(id);
+      }
+    }
+    starting.clear();
+
+    bool progressed = false;
+    if (!requests.empty()) {
+      int count = 0;
+      indices.resize(requests.size());
+      MPI_Testsome(static_cast<int>(requests.size()), requests.data(), &count,
+                   indices.data(), MPI_STATUSES_IGNORE);
+      if (MPI_UNDEFINED != count && count > 0) {
+        progressed = true;
+        for (int i = 0; i < count; ++i) {
+          const auto id = owners[indices[i]];
+          if (0 == --outstanding[id]) {
+            nodes[id].end_ns = elapsed();
+            outstanding.erase(id);
+            release(id);
+          }
+        }
+        // drop completed requests, which MPI_Testsome set to MPI_REQUEST_NULL
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < requests.size(); ++i) {
+          if (MPI_REQUEST_NULL != requests[i]) {
+            requests[kept] = requests[i];
+            owners[kept] = owners[i];
+            ++kept;
+          }
+        }
+        requests.resize(kept);
+        owners.resize(kept);
+      }
+    }
+
+    // between polls the calling thread works through compute tasks
+    if (!progressed && !pool->help()) {
+      std::this_thread::yield();
+    }
+  }
+
+  pool->join(compute_group);
+  group = nullptr;
+  mgr.timer_stop();
+}
+
+void TaskGraph::trace(const std::string &path) const {
+  // threads are numbered in order of first appearance, the calling thread
+  // of run being zero
+  std::map<std::thread::id, int> threads{{owner, 0}};
+  const auto escape = [](const std::string &text) {
+    std::string escaped;
+    for (const char c : text) {
+      if ('"' == c || '\\' == c) {
+        escaped.push_back('\\');
+      }
+      escaped.push_back(c);
+    }
+    return escaped;
+  };
+
+  std::string events;
+  for (const auto &node : nodes) {
+    const auto [it, inserted] =
+        threads.try_emplace(node.thread, static_cast<int>(threads.size()));
+    events += fmt::format(
+        R"({{"name":"{}","cat":"{}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{}}},)",
+        escape(node.name), TaskKind::compute == node.kind ? "compute" : "communicate",
+        1e-3 * static_cast<double>(node.begin_ns),
+        1e-3 * static_cast<double>(node.end_ns - node.begin_ns), mgr.rank,
+        it->second);
+  }
+
+  int bytes = static_cast<int>(events.size());
+  std::vector<int> counts(0 == mgr.rank ? mgr.size : 0);
+  MPI_Gather(&bytes, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, mgr.comm);
+  std::vector<int> displs(counts.size());
+  std::string gathered;
+  if (0 == mgr.rank) {
+    for (int i = 0, offset = 0; i < mgr.size; ++i) {
+      displs[i] = offset;
+      offset += counts[i];
+    }
+    gathered.resize(displs.back() + counts.back());
+  }
+  MPI_Gatherv(events.data(), bytes, MPI_CHAR, gathered.data(), counts.data(),
+              displs.data(), MPI_CHAR, 0, mgr.comm);
+
+  if (0 == mgr.rank) {
+    if (!gathered.empty()) {
+      gathered.pop_back();
+    }
+    std::ofstream(path) << R"({"traceEvents":[)" << gathered << "]}\n";
+  }
+}
+
+void TaskGraph::execute(const TaskId id) {
+  auto &node = nodes[id];
+  node.thread = std::this_thread::get_id();
+  node.begin_ns = elapsed();
+  node.fn();
+  node.end_ns = elapsed();
+  release(id);
+}
+
+void TaskGraph::release(const TaskId id) {
+  for (const auto successor : nodes[id].successors) {
+    if (1 == remaining[successor].fetch_sub(1)) {
+      ready(successor);
+    }
+  }
+  finished.fetch_add(1);
+}
+
+void TaskGraph::ready(const TaskId id) {
+  if (TaskKind::compute == nodes[id].kind) {
+    pool->spawn(*group, [this, id] { execute(id); });
+  } else {
+    std::lock_guard lock(ready_mutex);
+    ready_comms.push_back(id);
+  }
+}
+
+std::int64_t TaskGraph::elapsed() const {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
@@ -0,0 +1,135 @@
+#include "mpimgr_histogram.h"
+#include "mpimgr_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+
+Histogram::Histogram(MPIManager &mgr, const std::size_t bins,
+                     const double lower, const double upper)
+    : mgr(mgr), bins(std::max<std::size_t>(bins, 1)), lower(lower),
+      upper(upper), scale(static_cast<double>(this->bins) / (upper - lower)),
+      tally(this->bins + 2, 0) {}
+
+void Histogram::fit(const std::span<const double> values) {
+  // negating the minimum lets one MPI_MAX reduction find both extremes
+  double extremes[2] = {-std::numeric_limits<double>::infinity(),
+                        -std::numeric_limits<double>::infinity()};
+  for (const double value : values) {
+    extremes[0] = std::max(extremes[0], -value);
+    extremes[1] = std::max(extremes[1], value);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, extremes, 2, MPI_DOUBLE, MPI_MAX, mgr.comm);
+
+  lower = -extremes[0];
+  upper = extremes[1];
+  if (!(lower < upper)) {
+    // no values or a single distinct value, keep the bins well defined
+    lower = std::isfinite(lower) ? lower : 0.0;
+    upper = lower + 1.0;
+  }
+  // nudge the upper edge until the largest value lands in the last bin
+  // despite rounding in the bin computation
+  const double largest = upper;
+  do {
+    upper = std::nextafter(upper, std::numeric_limits<double>::infinity());
+    scale = static_cast<double>(bins) / (upper - lower);
+  } while ((largest - lower) * scale >= static_cast<double>(bins));
+  clear();
+}
+
+void Histogram::add(const std::span<const double> values) {
+  bin(values, tally);
+}
+
+void Histogram::add_parallel(const std::span<const double> values) {
+  auto &pool = mgr.pool();
+  const std::size_t threads = std::min(pool.concurrency(), values.size());
+  if (threads < 2) {
+    add(values);
+    return;
+  }
+
+  std::vector<std::vector<std::uint64_t>> partial(
+      threads, std::vector<std::uint64_t>(tally.size(), 0));
+  pool.parallel_for(0, threads, [&](const std::size_t t) {
+    const std::size_t first = values.size() * t / threads;
+    const std::size_t last = values.size() * (t + 1) / threads;
+    bin(values.subspan(first, last - first), partial[t]);
+  });
+  for (const auto &counts : partial) {
+    for (std::size_t i = 0; i < tally.size(); ++i) {
+      tally[i] += counts[i];
+    }
+  }
+}
+
+void Histogram::reduce() {
+  MPI_Allreduce(MPI_IN_PLACE, tally.data(), static_cast<int>(tally.size()),
+                MPI_UINT64_T, MPI_SUM, mgr.comm);
+}
+
+void Histogram::reduce(const std::span<Histogram> histograms) {
+  if (histograms.empty()) {
+    return;
+  }
+
+  std::vector<std::uint64_t> packed;
+  for (const auto &histogram : histograms) {
+    packed.insert(packed.end(), histogram.tally.begin(),
+                  histogram.tally.end());
+  }
+  MPI_Allreduce(MPI_IN_PLACE, packed.data(), static_cast<int>(packed.size()),
+                MPI_UINT64_T, MPI_SUM, histograms.front().mgr.comm);
+  auto it = packed.begin();
+  for (auto &histogram : histograms) {
+    std::copy_n(it, histogram.tally.size(), histogram.tally.begin());
+    it += static_cast<std::ptrdiff_t>(histogram.tally.size());
+  }
+}
+
+void Histogram::clear() { std::ranges::fill(tally, 0); }
+
+std::span<const std::uint64_t> Histogram::counts() const {
+  return std::span(tally).subspan(1, bins);
+}
+
+std::uint64_t Histogram::underflow() const { return tally.front(); }
+
+std::uint64_t Histogram::overflow() const { return tally.back(); }
+
+double Histogram::edge(const std::size_t bin) const {
+  return lower + static_cast<double>(bin) / scale;
+}
+
+void Histogram::bin(const std::span<const double> values,
+                    const std::span<std::uint64_t> counts) const {
+  // slot indices are computed a block at a time without branches so the
+  // loop vectorizes, the scatter into the counts follows separately
+  constexpr std::size_t block = 256;
+  std::uint32_t slots[block];
+  const double top = static_cast<double>(bins);
+  constexpr std::uint64_t magnitude = ~(std::uint64_t{1} << 63);
+  constexpr auto infinity =
+      std::bit_cast<std::uint64_t>(std::numeric_limits<double>::infinity());
+  for (std::size_t i = 0; i < values.size(); i += block) {
+    const std::size_t m = std::min(block, values.size() - i);
+    for (std::size_t j = 0; j < m; ++j) {
+      // clamping to [-1, bins] maps underflow and NaN to slot 0 and overflow
+      // to slot bins + 1, NaN is told from its bits because -ffast-math
+      // lets the compiler fold away comparisons and std::isnan
+      const double value = values[i + j];
+      const bool nan = (std::bit_cast<std::uint64_t>(value) & magnitude) >
+                       infinity;
+      const double position = (value - lower) * scale;
+      const double clamped =
+          nan || !(value >= lower) ? -1.0 : std::min(top, position);
+      slots[j] = static_cast<std::uint32_t>(
+          static_cast<std::int64_t>(std::floor(clamped)) + 1);
+    }
+    for (std::size_t j = 0; j < m; ++j) {
+      ++counts[slots[j]];
+    }
+  }
+}
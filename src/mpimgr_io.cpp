@@ -0,0 +1,495 @@
+// wrappers must match the plain libc declarations
+#undef _FORTIFY_SOURCE
+
+#include "mpimgr_io.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdarg>
+#include <ctime>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+/*!
+ * tracked state of an open file descriptor
+ */
+struct FileState {
+  /// path the file was opened with
+  std::string path;
+
+  /// offset at which the previous access ended
+  off_t next = 0;
+};
+
+/*!
+ * process wide profiler state
+ */
+struct State {
+  /// guards all members
+  std::mutex mutex;
+
+  /// stack of running timer regions
+  std::vector<std::string> regions;
+
+  /// tracked file descriptors
+  std::unordered_map<int, FileState> files;
+
+  /// counters by region and path
+  std::map<std::pair<std::string, std::string>, IOCounters> records;
+};
+
+/*!
+ * returns the profiler state, which is intentionally leaked so wrappers
+ * remain usable during static destruction
+ * @return profiler state
+ */
+State &state() {
+  static auto *state = new State;
+  return *state;
+}
+
+/// set while the calling thread is inside a wrapper
+thread_local bool inside = false;
+
+/// file descriptors below this bound are looked up in the tracked bitmap
+constexpr int tracked_limit = 1 << 16;
+
+/// bitmap of tracked file descriptors, constant initialized so it is usable
+/// before any constructor runs
+std::atomic<std::uint64_t> tracked_bits[tracked_limit / 64] = {};
+
+/*!
+ * checks without locking if a file descriptor may be tracked, so accesses to
+ * sockets, pipes and ignored files skip timing altogether
+ * @param fd file descriptor
+ * @return boolean stating if the descriptor may be tracked, always true above
+ * tracked_limit where the map decides
+ */
+bool tracked(const int fd) {
+  if (fd < 0) {
+    return false;
+  }
+  if (fd >= tracked_limit) {
+    return true;
+  }
+  const auto bits = tracked_bits[fd / 64].load(std::memory_order_relaxed);
+  return 0 != (bits >> (fd % 64) & 1);
+}
+
+/*!
+ * sets or clears the tracked bit of a file descriptor
+ * @param fd file descriptor
+ * @param set boolean stating if the descriptor is tracked from now on
+ */
+void mark_tracked(const int fd, const bool set) {
+  if (fd < 0 || fd >= tracked_limit) {
+    return;
+  }
+  const auto bit = std::uint64_t{1} << (fd % 64);
+  if (set) {
+    tracked_bits[fd / 64].fetch_or(bit, std::memory_order_relaxed);
+  } else {
+    tracked_bits[fd / 64].fetch_and(~bit, std::memory_order_relaxed);
+  }
+}
+
+/*!
+ * resolves the next definition of a symbol
+ * @tparam F function pointer type
+ * @param name symbol name
+ * @return function pointer
+ */
+template <class F> F next(const char *name) {
+  return reinterpret_cast<F>(dlsym(RTLD_NEXT, name));
+}
+
+/*!
+ * checks if a path belongs to a pseudo or system file system
+ * @param path path to check
+ * @return boolean stating if the path is ignored
+ */
+bool ignored(const char *path) {
+  if (nullptr == path) {
+    return true;
+  }
+  for (const char *prefix : {"/proc/", "/sys/", "/dev/", "/etc/"}) {
+    if (0 == std::string_view(path).rfind(prefix, 0)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * returns the current time
+ * @return monotonic time in seconds
+ */
+double now() {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + 1e-9 * static_cast<double>(ts.tv_nsec);
+}
+
+/*!
+ * returns the counters of a path within the current region, state mutex must
+ * be held
+ * @param s profiler state
+ * @param path file path
+ * @return counters
+ */
+IOCounters &counters(State &s, const std::string &path) {
+  return s.records[{s.regions.empty() ? std::string{} : s.regions.back(),
+                    path}];
+}
+
+/*!
+ * records an open of a path
+ * @param fd returned file descriptor
+ * @param path file path
+ * @param seconds time spent
+ */
+void record_open(const int fd, const char *path, const double seconds) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  auto &c = counters(s, path);
+  ++c.opens;
+  c.meta_time += seconds;
+  if (fd >= 0) {
+    s.files[fd] = {path, 0};
+    mark_tracked(fd, true);
+  }
+}
+
+/*!
+ * records a stat of a path
+ * @param path file path
+ * @param seconds time spent
+ */
+void record_stat(const char *path, const double seconds) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  auto &c = counters(s, path);
+  ++c.stats;
+  c.meta_time += seconds;
+}
+
+/*!
+ * records a sync of a file descriptor
+ * @param fd file descriptor
+ * @param seconds time spent
+ */
+void record_sync(const int fd, const double seconds) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  if (const auto it = s.files.find(fd); it != s.files.end()) {
+    auto &c = counters(s, it->second.path);
+    ++c.syncs;
+    c.meta_time += seconds;
+  }
+}
+
+/*!
+ * records a data access of a file descriptor
+ * @param fd file descriptor
+ * @param write boolean stating if the access was a write
+ * @param offset file offset of the access, -1 to query the file position
+ * @param bytes bytes transferred, negative on failure
+ * @param seconds time spent
+ */
+void record_access(const int fd, const bool write, off_t offset,
+                   const ssize_t bytes, const double seconds) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  const auto it = s.files.find(fd);
+  if (it == s.files.end()) {
+    return;
+  }
+
+  // only tracked files pay for the extra lseek of implicit offset accesses
+  if (offset < 0 && bytes >= 0) {
+    static const auto real_lseek = next<off_t (*)(int, off_t, int)>("lseek");
+    if (const off_t position = real_lseek(fd, 0, SEEK_CUR); position >= 0) {
+      offset = position - static_cast<off_t>(bytes);
+    }
+  }
+
+  auto &c = counters(s, it->second.path);
+  const auto size = static_cast<std::uint64_t>(bytes > 0 ? bytes : 0);
+  if (write) {
+    ++c.writes;
+    c.write_bytes += size;
+    c.write_time += seconds;
+  } else {
+    ++c.reads;
+    c.read_bytes += size;
+    c.read_time += seconds;
+  }
+
+  // bins grow by a factor of four starting at 256 bytes
+  const auto width = static_cast<std::size_t>(std::bit_width(size));
+  const std::size_t bin = width <= 8 ? 0 : (width - 9) / 2 + 1;
+  ++c.histogram[std::min(bin, io_histogram_bins - 1)];
+
+  if (offset == it->second.next) {
+    ++c.sequential;
+  } else {
+    ++c.random;
+  }
+  if (offset >= 0) {
+    it->second.next = offset + static_cast<off_t>(size);
+  }
+}
+
+/*!
+ * marks the calling thread as inside a wrapper for the lifetime of the guard
+ */
+struct Guard {
+  /// boolean stating if the wrapper should record, false on reentry
+  const bool active = !inside;
+
+  Guard() { inside = true; }
+
+  ~Guard() { inside = !active; }
+};
+
+/*!
+ * wraps an open call
+ * @tparam F real function type
+ * @param real real function
+ * @param path file path
+ * @param flags open flags
+ * @param mode creation mode
+ * @return file descriptor
+ */
+template <class F>
+int wrap_open(F real, const char *path, const int flags, const mode_t mode) {
+  const Guard guard;
+  if (!guard.active || ignored(path)) {
+    return real(path, flags, mode);
+  }
+  const double start = now();
+  const int fd = real(path, flags, mode);
+  record_open(fd, path, now() - start);
+  return fd;
+}
+
+/*!
+ * wraps a stat call
+ * @tparam F real function type
+ * @tparam S stat structure type
+ * @param real real function
+ * @param path file path
+ * @param buf stat buffer
+ * @return status
+ */
+template <class F, class S> int wrap_stat(F real, const char *path, S *buf) {
+  const Guard guard;
+  if (!guard.active || ignored(path)) {
+    return real(path, buf);
+  }
+  const double start = now();
+  const int status = real(path, buf);
+  record_stat(path, now() - start);
+  return status;
+}
+
+/*!
+ * wraps a data access with an implicit offset
+ * @tparam F real function type
+ * @tparam B buffer type
+ * @param real real function
+ * @param write boolean stating if the access is a write
+ * @param fd file descriptor
+ * @param buf data buffer
+ * @param count bytes requested
+ * @return bytes transferred
+ */
+template <class F, class B>
+ssize_t wrap_access(F real, const bool write, const int fd, B buf,
+                    const size_t count) {
+  const Guard guard;
+  if (!guard.active || !tracked(fd)) {
+    return real(fd, buf, count);
+  }
+  const double start = now();
+  const ssize_t bytes = real(fd, buf, count);
+  record_access(fd, write, -1, bytes, now() - start);
+  return bytes;
+}
+
+/*!
+ * wraps a data access with an explicit offset
+ * @tparam F real function type
+ * @tparam B buffer type
+ * @param real real function
+ * @param write boolean stating if the access is a write
+ * @param fd file descriptor
+ * @param buf data buffer
+ * @param count bytes requested
+ * @param offset file offset
+ * @return bytes transferred
+ */
+template <class F, class B>
+ssize_t wrap_positional(F real, const bool write, const int fd, B buf,
+                        const size_t count, const off_t offset) {
+  const Guard guard;
+  if (!guard.active || !tracked(fd)) {
+    return real(fd, buf, count, offset);
+  }
+  const double start = now();
+  const ssize_t bytes = real(fd, buf, count, offset);
+  record_access(fd, write, offset, bytes, now() - start);
+  return bytes;
+}
+
+/*!
+ * wraps a sync call
+ * @tparam F real function type
+ * @param real real function
+ * @param fd file descriptor
+ * @return status
+ */
+template <class F> int wrap_sync(F real, const int fd) {
+  const Guard guard;
+  if (!guard.active || !tracked(fd)) {
+    return real(fd);
+  }
+  const double start = now();
+  const int status = real(fd);
+  record_sync(fd, now() - start);
+  return status;
+}
+
+/*!
+ * extracts the optional mode argument of open
+ * @param flags open flags
+ * @param args variadic arguments following flags
+ * @return creation mode
+ */
+mode_t open_mode(const int flags, va_list args) {
+  if (0 != (flags & O_CREAT) || O_TMPFILE == (flags & O_TMPFILE)) {
+    return static_cast<mode_t>(va_arg(args, int));
+  }
+  return 0;
+}
+
+void region_push(const char *name) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  s.regions.emplace_back(name);
+}
+
+void region_pop() {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  if (!s.regions.empty()) {
+    s.regions.pop_back();
+  }
+}
+
+void snapshot(std::vector<IORecord> &records) {
+  auto &s = state();
+  std::lock_guard lock(s.mutex);
+  records.clear();
+  for (const auto &[key, c] : s.records) {
+    records.push_back({key.first, key.second, c});
+  }
+}
+} // namespace
+
+extern "C" {
+const IOHooks mpimgr_io_hooks = {region_push, region_pop, snapshot};
+
+int open(const char *path, int flags, ...) {
+  static const auto real = next<int (*)(const char *, int, ...)>("open");
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = open_mode(flags, args);
+  va_end(args);
+  return wrap_open(real, path, flags, mode);
+}
+
+int open64(const char *path, int flags, ...) {
+  static const auto real = next<int (*)(const char *, int, ...)>("open64");
+  va_list args;
+  va_start(args, flags);
+  const mode_t mode = open_mode(flags, args);
+  va_end(args);
+  return wrap_open(real, path, flags, mode);
+}
+
+int close(int fd) {
+  static const auto real = next<int (*)(int)>("close");
+  if (!inside && tracked(fd)) {
+    mark_tracked(fd, false);
+    auto &s = state();
+    std::lock_guard lock(s.mutex);
+    s.files.erase(fd);
+  }
+  return real(fd);
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+  static const auto real = next<ssize_t (*)(int, void *, size_t)>("read");
+  return wrap_access(real, false, fd, buf, count);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+  static const auto real =
+      next<ssize_t (*)(int, const void *, size_t)>("write");
+  return wrap_access(real, true, fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+  static const auto real =
+      next<ssize_t (*)(int, void *, size_t, off_t)>("pread");
+  return wrap_positional(real, false, fd, buf, count, offset);
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off64_t offset) {
+  static const auto real =
+      next<ssize_t (*)(int, void *, size_t, off64_t)>("pread64");
+  return wrap_positional(real, false, fd, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+  static const auto real =
+      next<ssize_t (*)(int, const void *, size_t, off_t)>("pwrite");
+  return wrap_positional(real, true, fd, buf, count, offset);
+}
+
+ssize_t pwrite64(int fd, const void *buf, size_t count, off64_t offset) {
+  static const auto real =
+      next<ssize_t (*)(int, const void *, size_t, off64_t)>("pwrite64");
+  return wrap_positional(real, true, fd, buf, count, offset);
+}
+
+int fsync(int fd) {
+  static const auto real = next<int (*)(int)>("fsync");
+  return wrap_sync(real, fd);
+}
+
+int fdatasync(int fd) {
+  static const auto real = next<int (*)(int)>("fdatasync");
+  return wrap_sync(real, fd);
+}
+
+int stat(const char *path, struct stat *buf) {
+  static const auto real =
+      next<int (*)(const char *, struct stat *)>("stat");
+  return wrap_stat(real, path, buf);
+}
+
+int stat64(const char *path, struct stat64 *buf) {
+  static const auto real =
+      next<int (*)(const char *, struct stat64 *)>("stat64");
+  return wrap_stat(real, path, buf);
+}
+}
@@ -0,0 +1,145 @@
+#include "mpimgr_partitioned.h"
+
+#include <algorithm>
+#include <thread>
+
+PartitionedSend::PartitionedSend(MPIManager &mgr, const void *buf,
+                                 const int partitions, const int count,
+                                 const MPI_Datatype type, const int dest,
+                                 const int tag)
+    : partitions(partitions),
+      direct(MPI_THREAD_MULTIPLE == mgr.thread_level),
+      owner(std::this_thread::get_id()),
+      marked(std::make_unique<std::atomic<bool>[]>(partitions)) {
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Psend_init(buf, partitions, count, type, dest, tag, mgr.comm,
+                 MPI_INFO_NULL, &request);
+#else
+  MPI_Aint lb = 0;
+  MPI_Aint extent = 0;
+  MPI_Type_get_extent(type, &lb, &extent);
+  requests.resize(partitions);
+  for (int p = 0; p < partitions; ++p) {
+    MPI_Send_init(static_cast<const char *>(buf) +
+                      static_cast<MPI_Aint>(p) * count * extent,
+                  count, type, dest, tag + p, mgr.comm, &requests[p]);
+  }
+#endif
+}
+
+PartitionedSend::~PartitionedSend() {
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Request_free(&request);
+  }
+  for (auto &r : requests) {
+    MPI_Request_free(&r);
+  }
+}
+
+void PartitionedSend::start() {
+  for (int p = 0; p < partitions; ++p) {
+    marked[p].store(false, std::memory_order_relaxed);
+  }
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Start(&request);
+#endif
+}
+
+void PartitionedSend::ready(const int partition) {
+  // the owning thread may always call MPI, so its partitions leave at once
+  if (!direct && std::this_thread::get_id() != owner) {
+    marked[partition].store(true, std::memory_order_release);
+    return;
+  }
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Pready(partition, request);
+#else
+  MPI_Start(&requests[partition]);
+#endif
+}
+
+void PartitionedSend::progress() {
+  if (direct) {
+    return;
+  }
+  for (int p = 0; p < partitions; ++p) {
+    if (marked[p].exchange(false, std::memory_order_acquire)) {
+#if MPIMANAGER_HAVE_PARTITIONED
+      MPI_Pready(p, request);
+#else
+      MPI_Start(&requests[p]);
+#endif
+    }
+  }
+}
+
+void PartitionedSend::wait() {
+  progress();
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+#else
+  MPI_Waitall(partitions, requests.data(), MPI_STATUSES_IGNORE);
+#endif
+}
+
+PartitionedRecv::PartitionedRecv(MPIManager &mgr, void *buf,
+                                 const int partitions, const int count,
+                                 const MPI_Datatype type, const int source,
+                                 const int tag)
+    : done(partitions, false) {
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Precv_init(buf, partitions, count, type, source, tag, mgr.comm,
+                 MPI_INFO_NULL, &request);
+#else
+  MPI_Aint lb = 0;
+  MPI_Aint extent = 0;
+  MPI_Type_get_extent(type, &lb, &extent);
+  requests.resize(partitions);
+  for (int p = 0; p < partitions; ++p) {
+    MPI_Recv_init(static_cast<char *>(buf) +
+                      static_cast<MPI_Aint>(p) * count * extent,
+                  count, type, source, tag + p, mgr.comm, &requests[p]);
+  }
+#endif
+}
+
+PartitionedRecv::~PartitionedRecv() {
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Request_free(&request);
+  }
+  for (auto &r : requests) {
+    MPI_Request_free(&r);
+  }
+}
+
+void PartitionedRecv::start() {
+  std::fill(done.begin(), done.end(), false);
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Start(&request);
+#else
+  MPI_Startall(static_cast<int>(requests.size()), requests.data());
+#endif
+}
+
+bool PartitionedRecv::arrived(const int partition) {
+  if (!done[partition]) {
+    int flag = 0;
+#if MPIMANAGER_HAVE_PARTITIONED
+    MPI_Parrived(request, partition, &flag);
+#else
+    MPI_Test(&requests[partition], &flag, MPI_STATUS_IGNORE);
+#endif
+    done[partition] = 0 != flag;
+  }
+  return done[partition];
+}
+
+void PartitionedRecv::wait() {
+#if MPIMANAGER_HAVE_PARTITIONED
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+#else
+  MPI_Waitall(static_cast<int>(requests.size()), requests.data(),
+              MPI_STATUSES_IGNORE);
+#endif
+  std::fill(done.begin(), done.end(), true);
+}
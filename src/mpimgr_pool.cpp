@@ -0,0 +1,292 @@
+#include "mpimgr_pool.h"
+
+#include <chrono>
+#include <climits>
+#include <exception>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+/// pool and worker index of the calling thread, if it is a pool worker
+thread_local const ThreadPool *current_pool = nullptr;
+thread_local std::size_t current_worker = 0;
+
+/*!
+ * returns the current time
+ * @return monotonic time in nanoseconds
+ */
+std::uint64_t now() {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+/*!
+ * blocks while a futex word holds an expected value
+ * @param word futex word
+ * @param expected value to block on
+ */
+void futex_wait(std::atomic<std::uint32_t> &word, const std::uint32_t expected) {
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word),
+          FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+/*!
+ * wakes threads blocked on a futex word
+ * @param word futex word
+ * @param count maximum number of threads to wake
+ */
+void futex_wake(std::atomic<std::uint32_t> &word, const int count) {
+  syscall(SYS_futex, reinterpret_cast<std::uint32_t *>(&word),
+          FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+} // namespace
+
+WorkDeque::WorkDeque(const std::int64_t capacity) {
+  auto &initial = buffers.emplace_back(std::make_unique<Buffer>(
+      capacity, std::make_unique<std::atomic<Task *>[]>(capacity)));
+  buffer.store(initial.get(), std::memory_order_relaxed);
+}
+
+void WorkDeque::push(Task *task) {
+  const auto b = bottom.load(std::memory_order_relaxed);
+  const auto t = top.load(std::memory_order_acquire);
+  auto *a = buffer.load(std::memory_order_relaxed);
+
+  // grow by copying live slots into a buffer twice the size
+  if (b - t > a->capacity - 1) {
+    auto &grown = buffers.emplace_back(std::make_unique<Buffer>(
+        2 * a->capacity,
+        std::make_unique<std::atomic<Task *>[]>(2 * a->capacity)));
+    for (auto i = t; i < b; ++i) {
+      grown->slots[i & (grown->capacity - 1)].store(
+          a->slots[i & (a->capacity - 1)].load(std::memory_order_relaxed),
+          std::memory_order_relaxed);
+    }
+    a = grown.get();
+    buffer.store(a, std::memory_order_release);
+  }
+
+  a->slots[b & (a->capacity - 1)].store(task, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+Task *WorkDeque::pop() {
+  const auto b = bottom.load(std::memory_order_relaxed) - 1;
+  auto *a = buffer.load(std::memory_order_relaxed);
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto t = top.load(std::memory_order_relaxed);
+
+  if (t > b) {
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  auto *task = a->slots[b & (a->capacity - 1)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // last task, race thieves for it
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      task = nullptr;
+    }
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return task;
+}
+
+Task *WorkDeque::steal() {
+  auto t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const auto b = bottom.load(std::memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+
+  const auto *a = buffer.load(std::memory_order_acquire);
+  auto *task = a->slots[t & (a->capacity - 1)].load(std::memory_order_relaxed);
+  if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                   std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return task;
+}
+
+bool WorkDeque::empty() const {
+  return top.load(std::memory_order_acquire) >=
+         bottom.load(std::memory_order_acquire);
+}
+
+ThreadPool::ThreadPool(const std::optional<std::size_t> workers) {
+  // the calling thread keeps the first CPU of its affinity mask
+  std::vector<int> cpus;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (0 == sched_getaffinity(0, sizeof(mask), &mask)) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &mask)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  const std::size_t count =
+      workers.value_or(cpus.size() > 1 ? cpus.size() - 1 : 0);
+
+  for (std::size_t i = 0; i < count; ++i) {
+    this->workers.push_back(std::make_unique<Worker>());
+  }
+  for (std::size_t i = 0; i < count; ++i) {
+    const int cpu = cpus.size() > 1 ? cpus[1 + i % (cpus.size() - 1)] : -1;
+    this->workers[i]->thread = std::thread(&ThreadPool::work, this, i, cpu);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  stopping.store(true);
+  epoch.fetch_add(1);
+  futex_wake(epoch, INT_MAX);
+  for (const auto &worker : workers) {
+    worker->thread.join();
+  }
+}
+
+void ThreadPool::spawn(TaskGroup &group, std::function<void()> fn) {
+  group.pending.fetch_add(1, std::memory_order_relaxed);
+  auto *task = new Task{std::move(fn), &group};
+
+  if (this == current_pool) {
+    workers[current_worker]->deque.push(task);
+  } else {
+    std::lock_guard lock(injected_mutex);
+    injected.push_back(task);
+    injected_size.fetch_add(1);
+  }
+  notify();
+}
+
+void ThreadPool::join(TaskGroup &group) {
+  while (0 != group.pending.load(std::memory_order_acquire)) {
+    if (auto *task = find()) {
+      run(task);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  if (group.failed.load(std::memory_order_relaxed)) {
+    group.failed.store(false, std::memory_order_relaxed);
+    std::rethrow_exception(std::exchange(group.error, nullptr));
+  }
+}
+
+bool ThreadPool::help() {
+  if (auto *task = find()) {
+    run(task);
+    return true;
+  }
+  return false;
+}
+
+std::size_t ThreadPool::concurrency() const { return workers.size() + 1; }
+
+std::vector<ThreadTimes> ThreadPool::times() const {
+  std::vector<ThreadTimes> times;
+  for (const auto &worker : workers) {
+    times.push_back({1e-9 * static_cast<double>(worker->busy.load()),
+                     1e-9 * static_cast<double>(worker->idle.load())});
+  }
+  return times;
+}
+
+void ThreadPool::work(const std::size_t index, const int cpu) {
+  current_pool = this;
+  current_worker = index;
+  if (cpu >= 0) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    sched_setaffinity(0, sizeof(mask), &mask);
+  }
+
+  auto &self = *workers[index];
+  auto mark = now();
+  while (!stopping.load(std::memory_order_relaxed)) {
+    if (auto *task = find()) {
+      const auto start = now();
+      self.idle.fetch_add(start - mark, std::memory_order_relaxed);
+      run(task);
+      mark = now();
+      self.busy.fetch_add(mark - start, std::memory_order_relaxed);
+      continue;
+    }
+
+    // announce parking, then look once more so no notification is lost
+    const auto seen = epoch.load();
+    sleepers.fetch_add(1);
+    bool work = 0 != injected_size.load();
+    for (const auto &worker : workers) {
+      work = work || !worker->deque.empty();
+    }
+    if (!work && !stopping.load()) {
+      futex_wait(epoch, seen);
+    }
+    sleepers.fetch_sub(1);
+  }
+  const auto end = now();
+  self.idle.fetch_add(end - mark, std::memory_order_relaxed);
+}
+
+Task *ThreadPool::find() {
+  const bool worker = this == current_pool;
+  if (worker) {
+    if (auto *task = workers[current_worker]->deque.pop()) {
+      return task;
+    }
+  }
+
+  if (0 != injected_size.load()) {
+    std::lock_guard lock(injected_mutex);
+    if (!injected.empty()) {
+      auto *task = injected.front();
+      injected.pop_front();
+      injected_size.fetch_sub(1);
+      return task;
+    }
+  }
+
+  // steal starting after the calling worker to spread contention
+  const std::size_t n = workers.size();
+  const std::size_t first = worker ? current_worker + 1 : 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (auto *task = workers[(first + i) % n]->deque.steal()) {
+      return task;
+    }
+  }
+  return nullptr;
+}
+
+void ThreadPool::run(Task *task) {
+  // an exception must neither reach a worker's std::thread nor leave join
+  // while sibling tasks still use the group, so it waits in the group
+  auto &group = *task->group;
+  try {
+    task->fn();
+  } catch (...) {
+    if (!group.failed.exchange(true, std::memory_order_relaxed)) {
+      group.error = std::current_exception();
+    }
+  }
+  delete task;
+  group.pending.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::notify() {
+  epoch.fetch_add(1);
+  if (0 != sleepers.load()) {
+    futex_wake(epoch, 1);
+  }
+}
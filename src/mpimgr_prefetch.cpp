@@ -0,0 +1,123 @@
+#include "mpimgr_prefetch.h"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Prefetcher::Prefetcher(MPIManager &mgr, std::vector<PrefetchItem> schedule)
+    : mgr(mgr), schedule(std::move(schedule)), loading(!this->schedule.empty()),
+      loader([this](const std::stop_token stop) { load(stop); }) {}
+
+Prefetcher::~Prefetcher() {
+  loader.request_stop();
+  cv.notify_all();
+}
+
+bool Prefetcher::swap() {
+  const std::size_t next =
+      std::numeric_limits<std::size_t>::max() == position ? 0 : position + 1;
+  if (next >= schedule.size()) {
+    mgr.abort(fmt::format("Prefetcher: swap past the end of a schedule of {} "
+                          "items",
+                          schedule.size()));
+  }
+
+  mgr.timer_start(Level::debug, "Prefetcher wait");
+  const auto start = std::chrono::steady_clock::now();
+  bool on_time = true;
+  {
+    std::unique_lock lock(mutex);
+    on_time = !loading;
+    cv.wait(lock, [this] { return !loading; });
+    if (!error.empty()) {
+      mgr.abort(error);
+    }
+    data.swap(pending);
+    position = requested;
+    if (position + 1 < schedule.size()) {
+      requested = position + 1;
+      loading = true;
+    }
+  }
+  cv.notify_all();
+  const std::chrono::duration<double> waited =
+      std::chrono::steady_clock::now() - start;
+  mgr.timer_stop();
+
+  // only waits that were actually needed count as stalls
+  double worst = on_time ? 0.0 : waited.count();
+  stall += worst;
+  int late = on_time ? 0 : 1;
+  MPI_Allreduce(MPI_IN_PLACE, &worst, 1, MPI_DOUBLE, MPI_MAX, mgr.comm);
+  MPI_Allreduce(MPI_IN_PLACE, &late, 1, MPI_INT, MPI_SUM, mgr.comm);
+  if (late > 0) {
+    mgr.log(Level::warning,
+            fmt::format("Prefetcher: item {} arrived late on {} of {} ranks, "
+                        "longest stall: {:.6f} s",
+                        position, late, mgr.size, worst));
+  }
+  return on_time;
+}
+
+std::span<const std::byte> Prefetcher::current() const { return data; }
+
+std::size_t Prefetcher::index() const { return position; }
+
+double Prefetcher::stalled() const { return stall; }
+
+void Prefetcher::load(const std::stop_token stop) {
+  while (true) {
+    std::size_t item = 0;
+    {
+      std::unique_lock lock(mutex);
+      cv.wait(lock, stop, [this] { return loading; });
+      if (stop.stop_requested()) {
+        return;
+      }
+      item = requested;
+    }
+
+    // pending is only touched by this thread while loading is set
+    const auto &[path, offset, bytes] = schedule[item];
+    std::string failure;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st = {};
+    if (fd < 0 || 0 != fstat(fd, &st)) {
+      failure = fmt::format("Prefetcher: cannot open `{}`: {}", path,
+                            std::strerror(errno));
+    } else {
+      const auto size = static_cast<std::uint64_t>(st.st_size);
+      const auto length =
+          offset < size ? std::min(bytes, size - offset) : std::uint64_t{0};
+      pending.resize(length);
+      for (std::uint64_t done = 0; done < length && failure.empty();) {
+        const auto n = pread(fd, pending.data() + done, length - done,
+                             static_cast<off_t>(offset + done));
+        if (n < 0 && EINTR == errno) {
+          continue;
+        }
+        if (n <= 0) {
+          failure = fmt::format("Prefetcher: cannot read `{}`: {}", path,
+                                0 == n ? "unexpected end of file"
+                                       : std::strerror(errno));
+        }
+        done += n > 0 ? static_cast<std::uint64_t>(n) : 0;
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+
+    {
+      std::lock_guard lock(mutex);
+      error = std::move(failure);
+      loading = false;
+    }
+    cv.notify_all();
+  }
+}
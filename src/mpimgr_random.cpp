@@ -0,0 +1,249 @@
+#include "mpimgr_random.h"
+
+#include <cmath>
+#include <immintrin.h>
+#include <numbers>
+#include <vector>
+
+namespace {
+/// Philox4x32 multipliers and Weyl key increments
+constexpr std::uint32_t M0 = 0xD2511F53;
+constexpr std::uint32_t M1 = 0xCD9E8D57;
+constexpr std::uint32_t W0 = 0x9E3779B9;
+constexpr std::uint32_t W1 = 0xBB67AE85;
+
+/// number of Philox rounds
+constexpr int rounds = 10;
+
+/*!
+ * computes Philox4x32-10 of one counter
+ * @param c counter words, replaced by the output
+ * @param k0 first key word
+ * @param k1 second key word
+ */
+void philox_scalar(std::uint32_t c[4], std::uint32_t k0, std::uint32_t k1) {
+  for (int r = 0; r < rounds; ++r) {
+    const std::uint64_t p0 = static_cast<std::uint64_t>(M0) * c[0];
+    const std::uint64_t p1 = static_cast<std::uint64_t>(M1) * c[2];
+    const std::uint32_t n0 = static_cast<std::uint32_t>(p1 >> 32) ^ c[1] ^ k0;
+    const std::uint32_t n2 = static_cast<std::uint32_t>(p0 >> 32) ^ c[3] ^ k1;
+    c[0] = n0;
+    c[1] = static_cast<std::uint32_t>(p1);
+    c[2] = n2;
+    c[3] = static_cast<std::uint32_t>(p0);
+    k0 += W0;
+    k1 += W1;
+  }
+}
+
+/*!
+ * computes Philox4x32-10 of 8 consecutive counters with AVX2
+ * @param out output of 32 words in block order
+ * @param counter first counter, the low word must not wrap within the batch
+ * @param c2 third counter word
+ * @param c3 fourth counter word
+ * @param k0 first key word
+ * @param k1 second key word
+ */
+__attribute__((target("avx2"))) void
+philox_avx2(std::uint32_t *out, const std::uint64_t counter,
+            const std::uint32_t c2, const std::uint32_t c3, std::uint32_t k0,
+            std::uint32_t k1) {
+  const auto lo = static_cast<std::uint32_t>(counter);
+  __m256i c[4] = {
+      _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(lo)),
+                       _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)),
+      _mm256_set1_epi32(static_cast<int>(counter >> 32)),
+      _mm256_set1_epi32(static_cast<int>(c2)),
+      _mm256_set1_epi32(static_cast<int>(c3))};
+  const __m256i m0 = _mm256_set1_epi32(static_cast<int>(M0));
+  const __m256i m1 = _mm256_set1_epi32(static_cast<int>(M1));
+
+  for (int r = 0; r < rounds; ++r) {
+    // 32x32->64 products of even lanes, then of odd lanes shifted down
+    const __m256i p0e = _mm256_mul_epu32(c[0], m0);
+    const __m256i p0o = _mm256_mul_epu32(_mm256_srli_epi64(c[0], 32), m0);
+    const __m256i p1e = _mm256_mul_epu32(c[2], m1);
+    const __m256i p1o = _mm256_mul_epu32(_mm256_srli_epi64(c[2], 32), m1);
+    const __m256i lo0 = _mm256_blend_epi32(p0e, _mm256_slli_epi64(p0o, 32), 0xAA);
+    const __m256i hi0 = _mm256_blend_epi32(_mm256_srli_epi64(p0e, 32), p0o, 0xAA);
+    const __m256i lo1 = _mm256_blend_epi32(p1e, _mm256_slli_epi64(p1o, 32), 0xAA);
+    const __m256i hi1 = _mm256_blend_epi32(_mm256_srli_epi64(p1e, 32), p1o, 0xAA);
+    c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]),
+                            _mm256_set1_epi32(static_cast<int>(k0)));
+    c[1] = lo1;
+    c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]),
+                            _mm256_set1_epi32(static_cast<int>(k1)));
+    c[3] = lo0;
+    k0 += W0;
+    k1 += W1;
+  }
+
+  alignas(32) std::uint32_t words[4][8];
+  for (int w = 0; w < 4; ++w) {
+    _mm256_store_si256(reinterpret_cast<__m256i *>(words[w]), c[w]);
+  }
+  for (int j = 0; j < 8; ++j) {
+    for (int w = 0; w < 4; ++w) {
+      out[4 * j + w] = words[w][j];
+    }
+  }
+}
+
+/*!
+ * computes Philox4x32-10 of 16 consecutive counters with AVX-512
+ * @param out output of 64 words in block order
+ * @param counter first counter, the low word must not wrap within the batch
+ * @param c2 third counter word
+ * @param c3 fourth counter word
+ * @param k0 first key word
+ * @param k1 second key word
+ */
+__attribute__((target("avx512f"))) void
+philox_avx512(std::uint32_t *out, const std::uint64_t counter,
+              const std::uint32_t c2, const std::uint32_t c3, std::uint32_t k0,
+              std::uint32_t k1) {
+  const auto lo = static_cast<std::uint32_t>(counter);
+  __m512i c[4] = {
+      _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(lo)),
+                       _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+                                         12, 13, 14, 15)),
+      _mm512_set1_epi32(static_cast<int>(counter >> 32)),
+      _mm512_set1_epi32(static_cast<int>(c2)),
+      _mm512_set1_epi32(static_cast<int>(c3))};
+  const __m512i m0 = _mm512_set1_epi32(static_cast<int>(M0));
+  const __m512i m1 = _mm512_set1_epi32(static_cast<int>(M1));
+  constexpr __mmask16 odd = 0xAAAA;
+
+  for (int r = 0; r < rounds; ++r) {
+    const __m512i p0e = _mm512_mul_epu32(c[0], m0);
+    const __m512i p0o = _mm512_mul_epu32(_mm512_srli_epi64(c[0], 32), m0);
+    const __m512i p1e = _mm512_mul_epu32(c[2], m1);
+    const __m512i p1o = _mm512_mul_epu32(_mm512_srli_epi64(c[2], 32), m1);
+    const __m512i lo0 = _mm512_mask_blend_epi32(odd, p0e, _mm512_slli_epi64(p0o, 32));
+    const __m512i hi0 = _mm512_mask_blend_epi32(odd, _mm512_srli_epi64(p0e, 32), p0o);
+    const __m512i lo1 = _mm512_mask_blend_epi32(odd, p1e, _mm512_slli_epi64(p1o, 32));
+    const __m512i hi1 = _mm512_mask_blend_epi32(odd, _mm512_srli_epi64(p1e, 32), p1o);
+    c[0] = _mm512_xor_si512(_mm512_xor_si512(hi1, c[1]),
+                            _mm512_set1_epi32(static_cast<int>(k0)));
+    c[1] = lo1;
+    c[2] = _mm512_xor_si512(_mm512_xor_si512(hi0, c[3]),
+                            _mm512_set1_epi32(static_cast<int>(k1)));
+    c[3] = lo0;
+    k0 += W0;
+    k1 += W1;
+  }
+
+  alignas(64) std::uint32_t words[4][16];
+  for (int w = 0; w < 4; ++w) {
+    _mm512_store_si512(words[w], c[w]);
+  }
+  for (int j = 0; j < 16; ++j) {
+    for (int w = 0; w < 4; ++w) {
+      out[4 * j + w] = words[w][j];
+    }
+  }
+}
+
+/// widest supported batch in blocks, 1 selects the scalar path
+const int lanes = __builtin_cpu_supports("avx512f") ? 16
+                  : __builtin_cpu_supports("avx2")  ? 8
+                                                    : 1;
+
+/*!
+ * converts two raw words to a uniform double in (0, 1)
+ * @param hi first word
+ * @param lo second word
+ * @return uniform
+ */
+double to_double(const std::uint32_t hi, const std::uint32_t lo) {
+  const std::uint64_t bits = (static_cast<std::uint64_t>(hi) << 32 | lo) >> 11;
+  return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+}
+} // namespace
+
+Philox::Philox(const std::uint64_t seed, const std::uint32_t rank,
+               const std::uint32_t stream)
+    : key{static_cast<std::uint32_t>(seed),
+          static_cast<std::uint32_t>(seed >> 32)},
+      stream(stream), rank(rank) {}
+
+Philox::Philox(const MPIManager &mgr, const std::uint64_t seed,
+               const std::uint32_t stream)
+    : Philox(seed, static_cast<std::uint32_t>(mgr.rank), stream) {}
+
+Philox::Block Philox::block(const std::uint64_t counter) const {
+  Block c = {static_cast<std::uint32_t>(counter),
+             static_cast<std::uint32_t>(counter >> 32), stream, rank};
+  philox_scalar(c.data(), key[0], key[1]);
+  return c;
+}
+
+void Philox::generate(std::uint32_t *out, std::size_t blocks) {
+  while (blocks > 0) {
+    const auto batch = static_cast<std::size_t>(lanes);
+    const auto lo = static_cast<std::uint32_t>(counter);
+    // batches must not carry from the low into the high counter word
+    if (batch > 1 && blocks >= batch && lo <= UINT32_MAX - (batch - 1)) {
+      if (16 == batch) {
+        philox_avx512(out, counter, stream, rank, key[0], key[1]);
+      } else {
+        philox_avx2(out, counter, stream, rank, key[0], key[1]);
+      }
+    } else {
+      const auto c = block(counter);
+      std::copy(c.begin(), c.end(), out);
+      out += 4;
+      ++counter;
+      --blocks;
+      continue;
+    }
+    out += 4 * batch;
+    counter += batch;
+    blocks -= batch;
+  }
+}
+
+void Philox::raw(const std::span<std::uint32_t> out) {
+  const std::size_t full = out.size() / 4;
+  generate(out.data(), full);
+  if (const std::size_t rest = out.size() - 4 * full; rest > 0) {
+    const auto c = block(counter++);
+    std::copy_n(c.begin(), rest, out.data() + 4 * full);
+  }
+}
+
+void Philox::uniform(const std::span<double> out) {
+  std::vector<std::uint32_t> words(2 * out.size() + 3);
+  generate(words.data(), (out.size() + 1) / 2);
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    out[i] = to_double(words[2 * i], words[2 * i + 1]);
+  }
+}
+
+void Philox::uniform(const std::span<float> out) {
+  std::vector<std::uint32_t> words(out.size() + 3);
+  generate(words.data(), (out.size() + 3) / 4);
+  for (std::size_t i = 0; i < out.size(); ++i) {
+    out[i] = (static_cast<float>(words[i] >> 8) + 0.5f) * 0x1.0p-24f;
+  }
+}
+
+void Philox::normal(const std::span<double> out) {
+  std::vector<std::uint32_t> words(2 * out.size() + 3);
+  generate(words.data(), (out.size() + 1) / 2);
+  for (std::size_t i = 0; i < out.size(); i += 2) {
+    const double u1 = to_double(words[2 * i], words[2 * i + 1]);
+    const double u2 = to_double(words[2 * i + 2], words[2 * i + 3]);
+    const double r = std::sqrt(-2.0 * std::log(u1));
+    const double theta = 2.0 * std::numbers::pi * u2;
+    out[i] = r * std::cos(theta);
+    if (i + 1 < out.size()) {
+      out[i + 1] = r * std::sin(theta);
+    }
+  }
+}
+
+void Philox::seek(const std::uint64_t counter) { this->counter = counter; }
+
+std::uint64_t Philox::tell() const { return counter; }
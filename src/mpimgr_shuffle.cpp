@@ -0,0 +1,310 @@
+#include "mpimgr_shuffle.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <unistd.h>
+
+namespace {
+/// bytes of the length prefix of a serialized pair
+constexpr std::size_t prefix_size = 2 * sizeof(std::uint32_t);
+
+/// buffer of each run stream
+constexpr std::size_t stream_buffer = std::size_t{1} << 20;
+
+/// number of shuffles constructed by this process
+std::size_t shuffle_count = 0;
+
+/*!
+ * hashes a key, FNV-1a so every rank agrees on the owner of a key
+ * @param key key
+ * @return hash
+ */
+std::uint64_t hash(const std::string_view key) {
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  for (const char c : key) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+/*!
+ * appends a serialized pair to a buffer
+ * @param out buffer
+ * @param key key
+ * @param value value
+ */
+void append(std::string &out, const std::string_view key,
+            const std::string_view value) {
+  const std::uint32_t sizes[2] = {static_cast<std::uint32_t>(key.size()),
+                                  static_cast<std::uint32_t>(value.size())};
+  out.append(reinterpret_cast<const char *>(sizes), prefix_size);
+  out.append(key);
+  out.append(value);
+}
+
+/*!
+ * returns the size of the serialized pair at the start of a buffer
+ * @param data serialized pairs
+ * @return bytes
+ */
+std::size_t record_size(const char *data) {
+  std::uint32_t sizes[2];
+  std::memcpy(sizes, data, prefix_size);
+  return prefix_size + sizes[0] + sizes[1];
+}
+
+/*!
+ * position in one sorted source of pairs during the reduce merge
+ */
+struct Cursor {
+  /// spilled run, closed for the in-memory source
+  std::ifstream in;
+
+  /// next index into the in-memory pairs
+  std::size_t index = 0;
+
+  /// current key
+  std::string key;
+
+  /// current value
+  std::string value;
+
+  /// stream buffer of the run
+  std::unique_ptr<char[]> buffer;
+};
+} // namespace
+
+Shuffle::Shuffle(MPIManager &mgr, const std::size_t memory_limit,
+                 std::filesystem::path scratch)
+    : mgr(mgr), memory_limit(std::max<std::size_t>(memory_limit, 1 << 16)),
+      scratch(scratch.empty() ? std::filesystem::temp_directory_path()
+                              : std::move(scratch)),
+      serial(shuffle_count++), outgoing(mgr.size) {}
+
+Shuffle::~Shuffle() {
+  std::error_code ignored;
+  for (const auto &run : runs) {
+    std::filesystem::remove(run, ignored);
+  }
+}
+
+void Shuffle::emit(const std::string_view key, const std::string_view value) {
+  auto &out = outgoing[hash(key) % static_cast<std::uint64_t>(mgr.size)];
+  append(out, key, value);
+}
+
+void Shuffle::exchange() {
+  mgr.timer_start(Level::debug, "Shuffle exchange");
+
+  // every round sends at most a share of the memory limit to each rank, at
+  // least one pair so oversized pairs still make progress
+  const std::size_t share = std::max<std::size_t>(
+      std::min<std::size_t>(memory_limit / 4, INT_MAX / 2) / mgr.size, 1);
+  std::vector<std::size_t> sent(mgr.size, 0);
+  std::vector<int> sendcounts(mgr.size), recvcounts(mgr.size);
+  std::vector<int> sdispls(mgr.size), rdispls(mgr.size);
+  std::string sendbuf, recvbuf;
+
+  int more = 1;
+  while (0 != more) {
+    sendbuf.clear();
+    int local_more = 0;
+    for (int dest = 0; dest < mgr.size; ++dest) {
+      const auto &out = outgoing[dest];
+      std::size_t end = sent[dest];
+      while (end < out.size()) {
+        const auto size = record_size(out.data() + end);
+        if (end > sent[dest] && end + size - sent[dest] > share) {
+          break;
+        }
+        end += size;
+      }
+      sdispls[dest] = static_cast<int>(sendbuf.size());
+      sendcounts[dest] = static_cast<int>(end - sent[dest]);
+      sendbuf.append(out, sent[dest], end - sent[dest]);
+      sent[dest] = end;
+      local_more |= end < out.size() ? 1 : 0;
+    }
+
+    MPI_Alltoall(sendcounts.data(), 1, MPI_INT, recvcounts.data(), 1, MPI_INT,
+                 mgr.comm);
+    int total = 0;
+    for (int source = 0; source < mgr.size; ++source) {
+      rdispls[source] = total;
+      total += recvcounts[source];
+    }
+    recvbuf.resize(total);
+    MPI_Alltoallv(sendbuf.data(), sendcounts.data(), sdispls.data(), MPI_CHAR,
+                  recvbuf.data(), recvcounts.data(), rdispls.data(), MPI_CHAR,
+                  mgr.comm);
+
+    for (std::size_t offset = 0; offset < recvbuf.size();) {
+      std::uint32_t sizes[2];
+      std::memcpy(sizes, recvbuf.data() + offset, prefix_size);
+      const char *key = recvbuf.data() + offset + prefix_size;
+      store({key, sizes[0]}, {key + sizes[0], sizes[1]});
+      offset += prefix_size + sizes[0] + sizes[1];
+    }
+
+    MPI_Allreduce(&local_more, &more, 1, MPI_INT, MPI_LOR, mgr.comm);
+  }
+
+  for (auto &out : outgoing) {
+    out.clear();
+    out.shrink_to_fit();
+  }
+
+  // spills happen on a varying number of ranks, so they are timed locally and
+  // reported here where every rank takes part
+  double spilled[2] = {spill_seconds, static_cast<double>(runs.size())};
+  MPI_Allreduce(MPI_IN_PLACE, spilled, 2, MPI_DOUBLE, MPI_MAX, mgr.comm);
+  if (spilled[1] > 0.0) {
+    mgr.log(Level::debug,
+            fmt::format("Shuffle: up to {:.0f} runs spilled per rank, "
+                        "spill time of the slowest rank: {:.6f} s",
+                        spilled[1], spilled[0]));
+  }
+  mgr.timer_stop();
+}
+
+void Shuffle::reduce(const Reducer &reducer) {
+  exchange();
+  mgr.timer_start(Level::debug, "Shuffle reduce");
+
+  // every spilled run and the in-memory pairs are sorted sources of one
+  // k-way merge, the in-memory pairs being the last source
+  std::ranges::sort(received);
+  std::vector<Cursor> cursors(runs.size() + 1);
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    auto &cursor = cursors[i];
+    cursor.buffer = std::make_unique<char[]>(stream_buffer);
+    cursor.in.rdbuf()->pubsetbuf(cursor.buffer.get(), stream_buffer);
+    cursor.in.open(runs[i], std::ios::binary);
+    if (!cursor.in) {
+      mgr.abort(fmt::format("Shuffle: cannot read spilled run `{}`",
+                            runs[i].string()));
+    }
+  }
+  const std::size_t memory = runs.size();
+
+  const auto advance = [&](const std::size_t i) {
+    auto &cursor = cursors[i];
+    if (memory == i) {
+      if (cursor.index == received.size()) {
+        return false;
+      }
+      cursor.key.swap(received[cursor.index].first);
+      cursor.value.swap(received[cursor.index].second);
+      ++cursor.index;
+      return true;
+    }
+    std::uint32_t sizes[2];
+    if (!cursor.in.read(reinterpret_cast<char *>(sizes), prefix_size)) {
+      return false;
+    }
+    cursor.key.resize(sizes[0]);
+    cursor.value.resize(sizes[1]);
+    cursor.in.read(cursor.key.data(), sizes[0]);
+    cursor.in.read(cursor.value.data(), sizes[1]);
+    return true;
+  };
+
+  const auto later = [&](const std::size_t a, const std::size_t b) {
+    return cursors[a].key > cursors[b].key;
+  };
+  std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)>
+      heap(later);
+  for (std::size_t i = 0; i < cursors.size(); ++i) {
+    if (advance(i)) {
+      heap.push(i);
+    }
+  }
+
+  std::string key;
+  std::vector<std::string> values;
+  std::vector<std::string_view> views;
+  const auto flush = [&] {
+    views.assign(values.begin(), values.end());
+    reducer(key, views);
+    values.clear();
+  };
+  while (!heap.empty()) {
+    const auto i = heap.top();
+    heap.pop();
+    if (!values.empty() && cursors[i].key != key) {
+      flush();
+    }
+    if (values.empty()) {
+      key = cursors[i].key;
+    }
+    values.push_back(std::move(cursors[i].value));
+    if (advance(i)) {
+      heap.push(i);
+    }
+  }
+  if (!values.empty()) {
+    flush();
+  }
+
+  cursors.clear();
+  received.clear();
+  received_bytes = 0;
+  std::error_code ignored;
+  for (const auto &run : runs) {
+    std::filesystem::remove(run, ignored);
+  }
+  runs.clear();
+  mgr.timer_stop();
+}
+
+std::size_t Shuffle::spills() const { return runs.size(); }
+
+void Shuffle::store(const std::string_view key, const std::string_view value) {
+  received.emplace_back(key, value);
+  received_bytes +=
+      sizeof(std::pair<std::string, std::string>) + key.size() + value.size();
+  if (received_bytes > memory_limit) {
+    spill();
+  }
+}
+
+void Shuffle::spill() {
+  const auto start = std::chrono::steady_clock::now();
+  std::ranges::sort(received);
+
+  auto path = scratch / fmt::format("mpimgr_shuffle_{}_{}_{}.run", getpid(),
+                                    serial, runs.size());
+  {
+    const auto buffer = std::make_unique<char[]>(stream_buffer);
+    std::ofstream out;
+    out.rdbuf()->pubsetbuf(buffer.get(), stream_buffer);
+    out.open(path, std::ios::binary | std::ios::trunc);
+    std::string record;
+    for (const auto &[key, value] : received) {
+      record.clear();
+      append(record, key, value);
+      out.write(record.data(), static_cast<std::streamsize>(record.size()));
+    }
+    out.close();
+    if (!out) {
+      mgr.abort(fmt::format("Shuffle: cannot write spilled run `{}`",
+                            path.string()));
+    }
+  }
+  runs.push_back(std::move(path));
+
+  received.clear();
+  received.shrink_to_fit();
+  received_bytes = 0;
+  spill_seconds += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+}
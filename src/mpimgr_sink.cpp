@@ -0,0 +1,226 @@
+#include "mpimgr_sink.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#ifdef MPIMANAGER_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+/*!
+ * releases the preallocated space past the written bytes and closes a file
+ * @param fd file descriptor
+ * @param size bytes written to the file
+ */
+void release(const int fd, const std::size_t size) {
+  // a failed truncation only leaves unused extents allocated
+  [[maybe_unused]] const int status = ftruncate(fd, static_cast<off_t>(size));
+  close(fd);
+}
+
+/*!
+ * releases the preallocated space of a rotated file, closes and compresses it
+ * @param fd file descriptor
+ * @param size bytes written to the file
+ * @param path path of the rotated file
+ * @param compress boolean stating if the file is gzipped
+ */
+void retire(const int fd, const std::size_t size, const std::string &path,
+            const bool compress) {
+  release(fd, size);
+#ifdef MPIMANAGER_ZLIB
+  if (!compress) {
+    return;
+  }
+  const int in = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  gzFile out = gzopen((path + ".gz").c_str(), "wb1");
+  if (-1 == in || nullptr == out) {
+    if (-1 != in) {
+      close(in);
+    }
+    if (nullptr != out) {
+      gzclose(out);
+    }
+    return;
+  }
+  std::vector<char> chunk(1 << 20);
+  bool complete = true;
+  for (ssize_t bytes; (bytes = read(in, chunk.data(), chunk.size())) != 0;) {
+    if (bytes < 0 && EINTR == errno) {
+      continue;
+    }
+    if (bytes < 0 || gzwrite(out, chunk.data(),
+                             static_cast<unsigned>(bytes)) != bytes) {
+      complete = false;
+      break;
+    }
+  }
+  close(in);
+  complete = Z_OK == gzclose(out) && complete;
+  std::remove((complete ? path : path + ".gz").c_str());
+#else
+  static_cast<void>(path);
+  static_cast<void>(compress);
+#endif
+}
+} // namespace
+
+FileSink::FileSink(std::string path, FileSinkOptions options)
+    : path(std::move(path)), options(options) {
+  buffer.reserve(options.buffer);
+  open_file();
+  background = std::jthread([this](const std::stop_token stop) { run(stop); });
+}
+
+FileSink::~FileSink() {
+  {
+    std::lock_guard lock(mutex);
+    if (-1 != fd) {
+      write_buffer();
+    }
+  }
+  // the background thread retires the files rotated so far before it exits
+  background.request_stop();
+  background.join();
+  if (-1 == fd) {
+    return;
+  }
+  release(fd, offset);
+}
+
+bool FileSink::is_open() const { return -1 != fd; }
+
+void FileSink::write(const std::string_view text) {
+  std::lock_guard lock(mutex);
+  if (-1 == fd) {
+    return;
+  }
+  buffer.append(text);
+  const std::chrono::duration<double> idle =
+      std::chrono::steady_clock::now() - flushed;
+  if (buffer.size() >= options.buffer ||
+      idle.count() >= options.flush_seconds) {
+    write_buffer();
+  }
+}
+
+void FileSink::flush() {
+  std::lock_guard lock(mutex);
+  if (-1 != fd) {
+    write_buffer();
+  }
+}
+
+void FileSink::write_buffer() {
+  flushed = std::chrono::steady_clock::now();
+  if (!buffer.empty()) {
+    // extents are allocated in large steps rather than on every write
+    if (options.preallocate > 0 && offset + buffer.size() > reserved) {
+      const std::size_t bytes = std::max(buffer.size(), options.preallocate);
+      if (0 == fallocate(fd, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+                         static_cast<off_t>(bytes))) {
+        reserved = offset + bytes;
+      }
+    }
+    std::size_t written = 0;
+    int error = 0;
+    while (written < buffer.size()) {
+      const ssize_t bytes =
+          pwrite(fd, buffer.data() + written, buffer.size() - written,
+                 static_cast<off_t>(offset + written));
+      if (bytes < 0 && EINTR == errno) {
+        continue;
+      }
+      if (bytes <= 0) {
+        error = bytes < 0 ? errno : EIO;
+        break;
+      }
+      written += static_cast<std::size_t>(bytes);
+    }
+
+    // lost bytes are dropped rather than left as a hole before later writes
+    if (written < buffer.size() && !failed) {
+      failed = true;
+      std::fprintf(stderr,
+                   "FileSink: writing %s failed, %zu bytes of log lost: %s\n",
+                   path.c_str(), buffer.size() - written,
+                   std::strerror(error));
+    }
+    offset += written;
+    buffer.clear();
+  }
+
+  const std::chrono::duration<double> age = flushed - opened;
+  if ((options.rotate_bytes > 0 && offset >= options.rotate_bytes) ||
+      (options.rotate_seconds > 0.0 && age.count() >= options.rotate_seconds &&
+       offset > 0)) {
+    rotate();
+  }
+}
+
+void FileSink::rotate() {
+  std::string name;
+  do {
+    name = fmt::format("{}.{}", path, rotation++);
+  } while (std::filesystem::exists(name) ||
+           std::filesystem::exists(name + ".gz"));
+  if (0 != std::rename(path.c_str(), name.c_str())) {
+    return;
+  }
+
+  rotated.push_back({fd, offset, std::move(name)});
+  wake.notify_one();
+  open_file();
+}
+
+void FileSink::run(const std::stop_token stop) {
+  const auto has_rotated = [this] { return !rotated.empty(); };
+  const std::chrono::duration<double> interval(options.flush_seconds);
+  std::unique_lock lock(mutex);
+  while (true) {
+    if (interval.count() > 0.0) {
+      wake.wait_for(lock, stop, interval, has_rotated);
+    } else {
+      // every write flushes, so only rotated files need the thread
+      wake.wait(lock, stop, has_rotated);
+    }
+
+    // compressing may take long, so it must not block logging
+    while (!rotated.empty()) {
+      const Rotated file = std::move(rotated.front());
+      rotated.pop_front();
+      lock.unlock();
+      retire(file.fd, file.size, file.path, options.compress);
+      lock.lock();
+    }
+    if (stop.stop_requested()) {
+      return;
+    }
+
+    const std::chrono::duration<double> idle =
+        std::chrono::steady_clock::now() - flushed;
+    if (-1 != fd && !buffer.empty() && idle >= interval) {
+      write_buffer();
+    }
+  }
+}
+
+void FileSink::open_file() {
+  fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  struct stat info {};
+  offset = -1 != fd && 0 == fstat(fd, &info)
+               ? static_cast<std::size_t>(info.st_size)
+               : 0;
+  reserved = offset;
+  opened = std::chrono::steady_clock::now();
+  flushed = opened;
+}
@@ -0,0 +1,338 @@
+#include "mpimgr_sketch.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace {
+/// bytes of the serialized header: k, level count, n, min, max and coin
+constexpr std::size_t header_size = 2 * sizeof(std::uint32_t) +
+                                    sizeof(std::uint64_t) +
+                                    2 * sizeof(double) + sizeof(std::uint64_t);
+
+/*!
+ * mixes the bits of a key, the MurmurHash3 64-bit finalizer
+ * @param key key
+ * @return hash
+ */
+constexpr std::uint64_t mix(std::uint64_t key) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  key *= 0xc4ceb9fe1a85ec53ull;
+  key ^= key >> 33;
+  return key;
+}
+
+/*!
+ * copies a value into a byte buffer
+ * @tparam T value type
+ * @param out output position, advanced past the value
+ * @param value value
+ */
+template <class T> void put(std::byte *&out, const T &value) {
+  std::memcpy(out, &value, sizeof(T));
+  out += sizeof(T);
+}
+
+/*!
+ * copies a value out of a byte buffer
+ * @tparam T value type
+ * @param in input position, advanced past the value
+ * @return value
+ */
+template <class T> T get(const std::byte *&in) {
+  T value;
+  std::memcpy(&value, in, sizeof(T));
+  in += sizeof(T);
+  return value;
+}
+
+/*!
+ * merges arrays of serialized KLL sketches, an MPI_User_function
+ * @param in sketches to merge
+ * @param inout sketches merged into
+ * @param len number of sketches
+ * @param type datatype of one serialized sketch
+ */
+void kll_merge(void *in, void *inout, int *len, MPI_Datatype *type) {
+  int bytes = 0;
+  MPI_Type_size(*type, &bytes);
+  const auto size = static_cast<std::size_t>(bytes);
+  for (int i = 0; i < *len; ++i) {
+    const std::span a(static_cast<const std::byte *>(in) + i * size, size);
+    const std::span b(static_cast<std::byte *>(inout) + i * size, size);
+    auto merged = KLLSketch::deserialize(b);
+    merged.merge(KLLSketch::deserialize(a));
+    merged.serialize(b);
+  }
+}
+} // namespace
+
+KLLSketch::KLLSketch(const std::uint32_t k)
+    : k(std::max<std::uint32_t>(k, 8)),
+      lowest(std::numeric_limits<double>::infinity()),
+      highest(-std::numeric_limits<double>::infinity()), levels(1) {}
+
+void KLLSketch::add(const double value) {
+  ++n;
+  lowest = std::min(lowest, value);
+  highest = std::max(highest, value);
+  levels[0].push_back(value);
+  if (levels[0].size() >= capacity(0)) {
+    compress();
+  }
+}
+
+void KLLSketch::add(const std::span<const double> values) {
+  if (values.empty()) {
+    return;
+  }
+  n += values.size();
+  const auto [lo, hi] = std::ranges::minmax(values);
+  lowest = std::min(lowest, lo);
+  highest = std::max(highest, hi);
+
+  // append in slices of the bottom capacity so compaction stays incremental
+  for (std::size_t i = 0; i < values.size();) {
+    const std::size_t room =
+        std::max(capacity(0), levels[0].size() + 1) - levels[0].size();
+    const std::size_t take = std::min(room, values.size() - i);
+    levels[0].insert(levels[0].end(), values.begin() + i,
+                     values.begin() + i + take);
+    i += take;
+    if (levels[0].size() >= capacity(0)) {
+      compress();
+    }
+  }
+}
+
+void KLLSketch::merge(const KLLSketch &other) {
+  if (other.levels.size() > levels.size()) {
+    levels.resize(other.levels.size());
+  }
+  for (std::size_t h = 0; h < other.levels.size(); ++h) {
+    levels[h].insert(levels[h].end(), other.levels[h].begin(),
+                     other.levels[h].end());
+  }
+  n += other.n;
+  lowest = std::min(lowest, other.lowest);
+  highest = std::max(highest, other.highest);
+  coin += other.coin;
+  compress();
+}
+
+double KLLSketch::quantile(const double q) const {
+  if (0 == n) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  if (q <= 0.0) {
+    return lowest;
+  }
+  if (q >= 1.0) {
+    return highest;
+  }
+
+  std::vector<std::pair<double, std::uint64_t>> weighted;
+  for (std::size_t h = 0; h < levels.size(); ++h) {
+    for (const double value : levels[h]) {
+      weighted.emplace_back(value, std::uint64_t{1} << h);
+    }
+  }
+  std::ranges::sort(weighted);
+
+  std::uint64_t total = 0;
+  for (const auto &[value, weight] : weighted) {
+    total += weight;
+  }
+  const double target = q * static_cast<double>(total);
+  std::uint64_t cumulative = 0;
+  for (const auto &[value, weight] : weighted) {
+    cumulative += weight;
+    if (static_cast<double>(cumulative) >= target) {
+      return value;
+    }
+  }
+  return highest;
+}
+
+std::uint64_t KLLSketch::count() const { return n; }
+
+double KLLSketch::min() const { return lowest; }
+
+double KLLSketch::max() const { return highest; }
+
+std::uint32_t KLLSketch::accuracy() const { return k; }
+
+std::size_t KLLSketch::serialized_size(const std::uint32_t k) {
+  const std::size_t items = 3 * std::max<std::size_t>(k, 8) + 2 * max_levels;
+  return header_size + max_levels * sizeof(std::uint32_t) +
+         items * sizeof(double);
+}
+
+void KLLSketch::serialize(const std::span<std::byte> out) const {
+  std::ranges::fill(out, std::byte{0});
+  auto *p = out.data();
+  put(p, k);
+  put(p, static_cast<std::uint32_t>(levels.size()));
+  put(p, n);
+  put(p, lowest);
+  put(p, highest);
+  put(p, coin);
+  for (std::size_t h = 0; h < max_levels; ++h) {
+    put(p, static_cast<std::uint32_t>(h < levels.size() ? levels[h].size()
+                                                        : 0));
+  }
+  for (const auto &level : levels) {
+    std::memcpy(p, level.data(), level.size() * sizeof(double));
+    p += level.size() * sizeof(double);
+  }
+}
+
+KLLSketch KLLSketch::deserialize(const std::span<const std::byte> in) {
+  const auto *p = in.data();
+  KLLSketch sketch(get<std::uint32_t>(p));
+  sketch.levels.resize(get<std::uint32_t>(p));
+  sketch.n = get<std::uint64_t>(p);
+  sketch.lowest = get<double>(p);
+  sketch.highest = get<double>(p);
+  sketch.coin = get<std::uint64_t>(p);
+  std::uint32_t sizes[max_levels];
+  for (auto &size : sizes) {
+    size = get<std::uint32_t>(p);
+  }
+  for (std::size_t h = 0; h < sketch.levels.size(); ++h) {
+    sketch.levels[h].resize(sizes[h]);
+    std::memcpy(sketch.levels[h].data(), p, sizes[h] * sizeof(double));
+    p += sizes[h] * sizeof(double);
+  }
+  return sketch;
+}
+
+std::size_t KLLSketch::capacity(const std::size_t level) const {
+  // capacities shrink geometrically by 2/3 from the top level down
+  const auto depth = static_cast<double>(levels.size() - 1 - level);
+  const auto scaled = std::ceil(k * std::pow(2.0 / 3.0, depth));
+  return std::max<std::size_t>(2, static_cast<std::size_t>(scaled));
+}
+
+void KLLSketch::compress() {
+  while (true) {
+    std::size_t size = 0;
+    std::size_t limit = 0;
+    for (std::size_t h = 0; h < levels.size(); ++h) {
+      size += levels[h].size();
+      limit += capacity(h);
+    }
+    if (size <= limit) {
+      return;
+    }
+
+    // compact the lowest full level by promoting every other sorted value
+    for (std::size_t h = 0; h < levels.size(); ++h) {
+      if (levels[h].size() < capacity(h)) {
+        continue;
+      }
+      if (h + 1 == levels.size()) {
+        levels.emplace_back();
+      }
+      auto &level = levels[h];
+      std::ranges::sort(level);
+      const bool odd = 1 == level.size() % 2;
+      const double kept = level.back();
+      const std::size_t pairs = level.size() / 2;
+      const std::size_t offset = coin++ & 1;
+      auto &above = levels[h + 1];
+      for (std::size_t i = 0; i < pairs; ++i) {
+        above.push_back(level[2 * i + offset]);
+      }
+      level.clear();
+      if (odd) {
+        level.push_back(kept);
+      }
+      break;
+    }
+  }
+}
+
+HyperLogLog::HyperLogLog(const int precision)
+    : precision(std::clamp(precision, 4, 18)),
+      regs(std::size_t{1} << this->precision, 0) {}
+
+void HyperLogLog::add(const std::uint64_t key) { update(mix(key)); }
+
+void HyperLogLog::add(const std::span<const std::uint64_t> keys) {
+  constexpr std::size_t batch = 256;
+  std::uint64_t hashes[batch];
+  for (std::size_t i = 0; i < keys.size(); i += batch) {
+    const std::size_t m = std::min(batch, keys.size() - i);
+    for (std::size_t j = 0; j < m; ++j) {
+      hashes[j] = mix(keys[i + j]);
+    }
+    for (std::size_t j = 0; j < m; ++j) {
+      update(hashes[j]);
+    }
+  }
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+  for (std::size_t i = 0; i < regs.size(); ++i) {
+    regs[i] = std::max(regs[i], other.regs[i]);
+  }
+}
+
+double HyperLogLog::estimate() const {
+  const auto m = static_cast<double>(regs.size());
+  double sum = 0.0;
+  std::size_t zeros = 0;
+  for (const auto reg : regs) {
+    sum += std::ldexp(1.0, -reg);
+    zeros += 0 == reg ? 1 : 0;
+  }
+  const double alpha = 0.7213 / (1.0 + 1.079 / m);
+  const double raw = alpha * m * m / sum;
+
+  // linear counting is more accurate while many registers are empty
+  if (raw <= 2.5 * m && zeros > 0) {
+    return m * std::log(m / static_cast<double>(zeros));
+  }
+  return raw;
+}
+
+std::span<std::uint8_t> HyperLogLog::registers() { return regs; }
+
+void HyperLogLog::update(const std::uint64_t hash) {
+  const std::size_t index = hash >> (64 - precision);
+  const std::uint64_t rest = hash << precision | std::uint64_t{1}
+                                                     << (precision - 1);
+  const auto rho = static_cast<std::uint8_t>(std::countl_zero(rest) + 1);
+  regs[index] = std::max(regs[index], rho);
+}
+
+void allreduce(MPIManager &mgr, KLLSketch &sketch) {
+  // sketches travel as one fixed size opaque element so the reduction tree
+  // can merge them pairwise, the merge being order sensitive through coin
+  const auto bytes = KLLSketch::serialized_size(sketch.accuracy());
+  std::vector<std::byte> buffer(bytes);
+  sketch.serialize(buffer);
+
+  MPI_Datatype type;
+  MPI_Type_contiguous(static_cast<int>(bytes), MPI_BYTE, &type);
+  MPI_Type_commit(&type);
+  MPI_Op op;
+  MPI_Op_create(kll_merge, 0, &op);
+  MPI_Allreduce(MPI_IN_PLACE, buffer.data(), 1, type, op, mgr.comm);
+  MPI_Op_free(&op);
+  MPI_Type_free(&type);
+
+  sketch = KLLSketch::deserialize(buffer);
+}
+
+void allreduce(MPIManager &mgr, HyperLogLog &sketch) {
+  // merging registers is an elementwise maximum, which MPI provides natively
+  const auto regs = sketch.registers();
+  MPI_Allreduce(MPI_IN_PLACE, regs.data(), static_cast<int>(regs.size()),
+                MPI_UINT8_T, MPI_MAX, mgr.comm);
+}
@@ -0,0 +1,117 @@
+#include "mpimgr_sort.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+ScratchFile::ScratchFile(MPIManager &mgr, const std::filesystem::path &dir)
+    : mgr(mgr) {
+  auto pattern =
+      ((dir.empty() ? std::filesystem::temp_directory_path() : dir) /
+       "mpimgr_scratch_XXXXXX")
+          .string();
+  fd = mkstemp(pattern.data());
+  if (fd < 0) {
+    mgr.abort(fmt::format("ScratchFile: cannot create `{}`: {}", pattern,
+                          std::strerror(errno)));
+  }
+  unlink(pattern.c_str());
+}
+
+ScratchFile::~ScratchFile() { close(fd); }
+
+std::uint64_t ScratchFile::append(const std::span<const std::byte> data) {
+  const auto offset = size;
+  write(offset, data);
+  return offset;
+}
+
+void ScratchFile::write(const std::uint64_t offset,
+                        const std::span<const std::byte> data) {
+  std::size_t done = 0;
+  while (done < data.size()) {
+    const auto n = pwrite(fd, data.data() + done, data.size() - done,
+                          static_cast<off_t>(offset + done));
+    if (n < 0 && EINTR == errno) {
+      continue;
+    }
+    if (n <= 0) {
+      mgr.abort(fmt::format("ScratchFile: write failed: {}",
+                            std::strerror(errno)));
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  size = std::max(size, offset + data.size());
+}
+
+void ScratchFile::read(const std::uint64_t offset,
+                       const std::span<std::byte> data) const {
+  if (const int error = try_read(offset, data); 0 != error) {
+    read_failed(error);
+  }
+}
+
+int ScratchFile::try_read(const std::uint64_t offset,
+                          const std::span<std::byte> data) const {
+  std::size_t done = 0;
+  while (done < data.size()) {
+    const auto n = pread(fd, data.data() + done, data.size() - done,
+                         static_cast<off_t>(offset + done));
+    if (n < 0 && EINTR == errno) {
+      continue;
+    }
+    if (n <= 0) {
+      return 0 == n ? EIO : errno;
+    }
+    done += static_cast<std::size_t>(n);
+  }
+  return 0;
+}
+
+void ScratchFile::read_failed(const int error) const {
+  mgr.abort(
+      fmt::format("ScratchFile: read failed: {}", std::strerror(error)));
+  std::abort();
+}
+
+ReadAhead::ReadAhead(ThreadPool &pool, const ScratchFile &file,
+                     const std::uint64_t begin, const std::uint64_t end,
+                     const std::size_t block)
+    : pool(pool), file(file), position(begin), end(end),
+      block(std::max<std::size_t>(block, 1)) {
+  prefetch();
+}
+
+ReadAhead::~ReadAhead() { pool.join(group); }
+
+std::span<const std::byte> ReadAhead::next() {
+  if (!in_flight) {
+    return {};
+  }
+  pool.join(group);
+  in_flight = false;
+  // the read ran on a pool worker, which must not call MPI
+  if (0 != error) {
+    file.read_failed(error);
+  }
+  current.swap(pending);
+  prefetch();
+  return current;
+}
+
+void ReadAhead::prefetch() {
+  if (position >= end) {
+    return;
+  }
+  const auto offset = position;
+  const auto size = static_cast<std::size_t>(
+      std::min<std::uint64_t>(block, end - position));
+  position += size;
+  in_flight = true;
+  pool.spawn(group, [this, offset, size] {
+    pending.resize(size);
+    error = file.try_read(offset, pending);
+  });
+}
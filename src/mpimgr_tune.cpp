@@ -0,0 +1,247 @@
+#include "mpimgr_tune.h"
+
+#include <fmt/format.h>
+#include <fmt/ranges.h>
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace {
+/*!
+ * hashes text, FNV-1a
+ * @param text text
+ * @return hash
+ */
+std::uint64_t hash(const std::string &text) {
+  std::uint64_t h = 0xcbf29ce484222325ull;
+  for (const char c : text) {
+    h ^= static_cast<unsigned char>(c);
+    h *= 0x100000001b3ull;
+  }
+  return h;
+}
+
+/*!
+ * returns the CPU model of this node
+ * @return model name from /proc/cpuinfo, empty if unavailable
+ */
+std::string cpu_model() {
+  std::ifstream in("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.starts_with("model name")) {
+      return line.substr(line.find(':') + 1);
+    }
+  }
+  return {};
+}
+
+/*!
+ * formats a configuration
+ * @param config configuration
+ * @return name=value pairs separated by spaces
+ */
+std::string describe(const TuneConfig &config) {
+  std::vector<std::string> pairs;
+  for (const auto &[key, value] : config) {
+    pairs.push_back(fmt::format("{}={}", key, value));
+  }
+  return fmt::format("{}", fmt::join(pairs, " "));
+}
+} // namespace
+
+Autotuner::Autotuner(MPIManager &mgr, std::string name, std::string cache,
+                     const std::size_t max_candidates)
+    : mgr(mgr), name(std::move(name)), cache(std::move(cache)),
+      max_candidates(std::max<std::size_t>(max_candidates, 1)) {}
+
+void Autotuner::parameter(const std::string &name,
+                          std::vector<std::int64_t> values) {
+  if (started) {
+    mgr.abort(fmt::format("Autotuner `{}`: parameter `{}` registered after "
+                          "the first run",
+                          this->name, name));
+  }
+  if (values.empty()) {
+    mgr.abort(fmt::format("Autotuner `{}`: parameter `{}` has no values",
+                          this->name, name));
+  }
+  parameters.emplace_back(name, std::move(values));
+}
+
+void Autotuner::run(const std::function<void(const TuneConfig &)> &kernel) {
+  if (!started) {
+    start();
+  }
+
+  const auto before = mgr.timer_stats(name);
+  mgr.timer_start(Level::debug, name);
+  kernel(config());
+  mgr.timer_stop();
+  if (locked) {
+    return;
+  }
+
+  times[cursor / repeats] +=
+      mgr.timer_stats(name)->total - (before ? before->total : 0.0);
+  ++iterations;
+  if (++cursor == survivors.size() * repeats) {
+    finish_round();
+  }
+}
+
+bool Autotuner::tuned() const { return locked; }
+
+const TuneConfig &Autotuner::config() const {
+  static const TuneConfig empty;
+  if (candidates.empty()) {
+    return empty;
+  }
+  return candidates[locked ? survivors.front() : survivors[cursor / repeats]];
+}
+
+void Autotuner::start() {
+  started = true;
+
+  // enumerate the product like an odometer over the registered values
+  std::size_t total = 1;
+  for (const auto &[key, values] : parameters) {
+    if (total > std::numeric_limits<std::size_t>::max() / values.size()) {
+      mgr.abort(fmt::format("Autotuner `{}`: parameter space is too large "
+                            "to index",
+                            name));
+    }
+    total *= values.size();
+  }
+
+  // Floyd's algorithm draws distinct indices without materializing the
+  // product, a fixed seed gives every rank the same sample
+  std::set<std::size_t> picks;
+  if (total <= max_candidates) {
+    for (std::size_t i = 0; i < total; ++i) {
+      picks.insert(i);
+    }
+  } else {
+    std::mt19937_64 rng(0x5eed);
+    for (std::size_t j = total - max_candidates; j < total; ++j) {
+      std::uniform_int_distribution<std::size_t> pick(0, j);
+      if (const auto index = pick(rng); !picks.insert(index).second) {
+        picks.insert(j);
+      }
+    }
+  }
+  for (auto index : picks) {
+    TuneConfig config;
+    for (auto it = parameters.rbegin(); it != parameters.rend(); ++it) {
+      config[it->first] = it->second[index % it->second.size()];
+      index /= it->second.size();
+    }
+    candidates.push_back(std::move(config));
+  }
+  survivors.resize(candidates.size());
+  std::iota(survivors.begin(), survivors.end(), 0);
+  times.assign(survivors.size(), 0.0);
+
+  // rank zero looks the fingerprint up and shares the cached candidate
+  long long cached = -1;
+  if (0 == mgr.rank && !cache.empty()) {
+    const auto key = fingerprint();
+    std::ifstream in(cache);
+    std::string line;
+    while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string entry;
+      fields >> entry;
+      if (key != entry) {
+        continue;
+      }
+      // a malformed line is skipped rather than thrown on before the Bcast
+      TuneConfig config;
+      std::string pair;
+      bool valid = true;
+      while (valid && fields >> pair) {
+        const auto eq = pair.find('=');
+        std::int64_t value = 0;
+        const char *last = pair.data() + pair.size();
+        const auto [end, error] =
+            std::string::npos == eq
+                ? std::from_chars_result{last, std::errc::invalid_argument}
+                : std::from_chars(pair.data() + eq + 1, last, value);
+        valid = std::errc{} == error && last == end && eq > 0;
+        config[pair.substr(0, eq)] = value;
+      }
+      if (!valid) {
+        continue;
+      }
+      const auto it = std::ranges::find(candidates, config);
+      cached = candidates.end() == it ? -1 : it - candidates.begin();
+    }
+  }
+  MPI_Bcast(&cached, 1, MPI_LONG_LONG, 0, mgr.comm);
+  if (cached >= 0) {
+    survivors = {static_cast<std::size_t>(cached)};
+    locked = true;
+    mgr.log(Level::info,
+            fmt::format("Autotuner `{}`: cached configuration {}", name,
+                        describe(candidates[cached])));
+  } else if (1 == candidates.size()) {
+    locked = true;
+  }
+}
+
+void Autotuner::finish_round() {
+  // the slowest rank judges every candidate
+  std::vector<double> means(times.size());
+  for (std::size_t i = 0; i < times.size(); ++i) {
+    means[i] = times[i] / static_cast<double>(repeats);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, means.data(), static_cast<int>(means.size()),
+                MPI_DOUBLE, MPI_MAX, mgr.comm);
+
+  std::vector<std::size_t> order(survivors.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order,
+                           [&](const std::size_t a, const std::size_t b) {
+                             return means[a] < means[b];
+                           });
+  std::vector<std::size_t> kept;
+  for (std::size_t i = 0; i < (survivors.size() + 1) / 2; ++i) {
+    kept.push_back(survivors[order[i]]);
+  }
+  const double best_mean = means[order.front()];
+  survivors = std::move(kept);
+  repeats *= 2;
+  cursor = 0;
+  times.assign(survivors.size(), 0.0);
+  if (survivors.size() > 1) {
+    return;
+  }
+
+  locked = true;
+  const auto &best = candidates[survivors.front()];
+  mgr.log(Level::info,
+          fmt::format("Autotuner `{}`: locked in {} ({:.6f} s) after {} runs",
+                      name, describe(best), best_mean, iterations));
+  if (0 == mgr.rank && !cache.empty()) {
+    std::ofstream(cache, std::ios::app)
+        << fingerprint() << ' ' << describe(best) << '\n';
+  }
+}
+
+std::string Autotuner::fingerprint() const {
+  std::string space;
+  for (const auto &[key, values] : parameters) {
+    space += fmt::format("{}:{};", key, fmt::join(values, ","));
+  }
+  const auto description = fmt::format(
+      "{}|{}|{}|{}|{}|{}", name, cpu_model(),
+      std::thread::hardware_concurrency(), mgr.size, mgr.node_size, space);
+  return fmt::format("{:016x}", hash(description));
+}
@@ -0,0 +1,169 @@
+#include "mpimgr_vector.h"
+
+#include <cmath>
+#include <immintrin.h>
+#include <utility>
+
+namespace {
+/*!
+ * computes y += a * x with AVX2 and FMA
+ * @param a scalar
+ * @param x input vector
+ * @param y input and output vector
+ * @param n number of elements
+ */
+__attribute__((target("avx2,fma"))) void
+axpy_avx2(const double a, const double *__restrict x, double *__restrict y,
+          const std::size_t n) {
+  const __m256d va = _mm256_set1_pd(a);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i),
+                                            _mm256_loadu_pd(y + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+/*!
+ * computes a dot product with AVX2 and FMA using four independent
+ * accumulators to hide FMA latency
+ * @param x first vector
+ * @param y second vector
+ * @param n number of elements
+ * @return dot product
+ */
+__attribute__((target("avx2,fma"))) double
+dot_avx2(const double *__restrict x, const double *__restrict y,
+         const std::size_t n) {
+  __m256d acc[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(),
+                    _mm256_setzero_pd(), _mm256_setzero_pd()};
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    for (int k = 0; k < 4; ++k) {
+      acc[k] = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4 * k),
+                               _mm256_loadu_pd(y + i + 4 * k), acc[k]);
+    }
+  }
+  for (; i + 4 <= n; i += 4) {
+    acc[0] = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i),
+                             acc[0]);
+  }
+  const __m256d sum4 =
+      _mm256_add_pd(_mm256_add_pd(acc[0], acc[1]), _mm256_add_pd(acc[2], acc[3]));
+  const __m128d sum2 = _mm_add_pd(_mm256_castpd256_pd128(sum4),
+                                  _mm256_extractf128_pd(sum4, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(sum2, _mm_unpackhi_pd(sum2, sum2)));
+  for (; i < n; ++i) {
+    sum += x[i] * y[i];
+  }
+  return sum;
+}
+
+/// boolean stating if the CPU supports the AVX2 kernels
+const bool has_avx2 =
+    __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+} // namespace
+
+void axpy(const double a, const std::span<const double> x,
+          const std::span<double> y) {
+  if (has_avx2) {
+    axpy_avx2(a, x.data(), y.data(), x.size());
+    return;
+  }
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    y[i] += a * x[i];
+  }
+}
+
+double dot_local(const std::span<const double> x,
+                 const std::span<const double> y) {
+  if (has_avx2) {
+    return dot_avx2(x.data(), y.data(), x.size());
+  }
+  double acc[4] = {};
+  std::size_t i = 0;
+  for (; i + 4 <= x.size(); i += 4) {
+    for (int k = 0; k < 4; ++k) {
+      acc[k] += x[i + k] * y[i + k];
+    }
+  }
+  for (; i < x.size(); ++i) {
+    acc[0] += x[i] * y[i];
+  }
+  return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+double dot(MPIManager &mgr, const std::span<const double> x,
+           const std::span<const double> y) {
+  double sum = dot_local(x, y);
+  MPI_Allreduce(MPI_IN_PLACE, &sum, 1, MPI_DOUBLE, MPI_SUM, mgr.comm);
+  return sum;
+}
+
+double norm(MPIManager &mgr, const std::span<const double> x) {
+  return std::sqrt(dot(mgr, x, x));
+}
+
+ReductionFuture::ReductionFuture(const MPI_Comm comm,
+                                 std::vector<double> values)
+    : values(std::move(values)) {
+  MPI_Iallreduce(MPI_IN_PLACE, this->values.data(),
+                 static_cast<int>(this->values.size()), MPI_DOUBLE, MPI_SUM,
+                 comm, &request);
+}
+
+ReductionFuture::~ReductionFuture() {
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+  }
+}
+
+ReductionFuture::ReductionFuture(ReductionFuture &&other) noexcept
+    : values(std::move(other.values)),
+      request(std::exchange(other.request, MPI_REQUEST_NULL)) {}
+
+ReductionFuture &ReductionFuture::operator=(ReductionFuture &&other) noexcept {
+  if (this != &other) {
+    if (MPI_REQUEST_NULL != request) {
+      MPI_Wait(&request, MPI_STATUS_IGNORE);
+    }
+    values = std::move(other.values);
+    request = std::exchange(other.request, MPI_REQUEST_NULL);
+  }
+  return *this;
+}
+
+bool ReductionFuture::ready() {
+  int flag = 1;
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Test(&request, &flag, MPI_STATUS_IGNORE);
+  }
+  return 0 != flag;
+}
+
+const std::vector<double> &ReductionFuture::get() {
+  if (MPI_REQUEST_NULL != request) {
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+  }
+  return values;
+}
+
+double ReductionFuture::operator[](const std::size_t i) { return get()[i]; }
+
+DotBatch::DotBatch(MPIManager &mgr) : comm(mgr.comm) {}
+
+std::size_t DotBatch::queue(const std::span<const double> x,
+                            const std::span<const double> y) {
+  return queue(dot_local(x, y));
+}
+
+std::size_t DotBatch::queue(const double value) {
+  values.push_back(value);
+  return values.size() - 1;
+}
+
+ReductionFuture DotBatch::start() {
+  return {comm, std::exchange(values, {})};
+}
@@ -0,0 +1,726 @@
+#include "mpimgr_pool.h"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+/// identifies index files and their layout version
+constexpr char index_magic[8] = {'M', 'P', 'I', 'M', 'G', 'R', 'Q', '1'};
+
+/// level tags in the order of the Level enum
+constexpr std::string_view level_tags[] = {"EMERG",   "ALERT",  "CRIT",
+                                           "ERR",     "WARNING", "NOTICE",
+                                           "INFO",    "DEBUG"};
+
+/// earliest and latest representable times
+constexpr std::int64_t time_min = std::numeric_limits<std::int64_t>::min();
+constexpr std::int64_t time_max = std::numeric_limits<std::int64_t>::max();
+
+/*!
+ * summary of a run of whole lines of a log file
+ */
+struct Block {
+  /// byte offset of the first line
+  std::uint64_t offset = 0;
+
+  /// bytes of the block
+  std::uint64_t bytes = 0;
+
+  /// earliest timestamp in microseconds since the epoch, time_min if none
+  std::int64_t first = time_max;
+
+  /// latest timestamp in microseconds since the epoch, time_max if none
+  std::int64_t last = time_min;
+
+  /// lowest rank, above rank_hi if no line names a rank
+  std::int32_t rank_lo = std::numeric_limits<std::int32_t>::max();
+
+  /// highest rank
+  std::int32_t rank_hi = -1;
+
+  /// bit i is set if a line was logged at the level with enum value i
+  std::uint32_t levels = 0;
+
+  /// number of lines
+  std::uint32_t lines = 0;
+};
+
+/*!
+ * header of an index file, followed by its blocks
+ */
+struct IndexHeader {
+  /// index_magic
+  char magic[8];
+
+  /// size of the indexed log file in bytes
+  std::uint64_t file_bytes;
+
+  /// modification time of the indexed log file in nanoseconds
+  std::int64_t file_mtime;
+
+  /// number of blocks
+  std::uint64_t blocks;
+};
+
+/*!
+ * filter of a query
+ */
+struct Query {
+  /// earliest time in microseconds since the epoch, inclusive
+  std::int64_t from = time_min;
+
+  /// latest time in microseconds since the epoch, exclusive
+  std::int64_t to = time_max;
+
+  /// time of day of from in microseconds if given without a date, or negative
+  std::int64_t from_clock = -1;
+
+  /// time of day of to in microseconds if given without a date, or negative
+  std::int64_t to_clock = -1;
+
+  /// inclusive rank ranges, empty selects all ranks
+  std::vector<std::pair<int, int>> ranks;
+
+  /// bit i selects the level with enum value i
+  std::uint32_t levels = 0xff;
+};
+
+/*!
+ * fields of a parsed log line
+ */
+struct Fields {
+  /// timestamp in microseconds since the epoch, kept from the previous line
+  /// if the line has none
+  std::int64_t time = time_min;
+
+  /// rank, -1 if the line does not name one
+  int rank = -1;
+
+  /// level enum value, -1 if the line does not name one
+  int level = -1;
+};
+
+/*!
+ * read-only mapping of a whole file
+ */
+class Mapping {
+public:
+  /*!
+   * maps a file
+   * @param path file path
+   */
+  explicit Mapping(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (-1 == fd) {
+      return;
+    }
+    struct stat info {};
+    if (0 == fstat(fd, &info)) {
+      bytes = static_cast<std::size_t>(info.st_size);
+      mtime = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+              info.st_mtim.tv_nsec;
+      valid = true;
+    }
+    if (bytes > 0) {
+      void *base = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+      data = MAP_FAILED == base ? nullptr : static_cast<const char *>(base);
+      valid = nullptr != data;
+    }
+    close(fd);
+  }
+
+  ~Mapping() {
+    if (nullptr != data) {
+      munmap(const_cast<char *>(data), bytes);
+    }
+  }
+
+  Mapping(const Mapping &) = delete;
+  Mapping &operator=(const Mapping &) = delete;
+
+  /// mapped bytes, nullptr if the file is empty or could not be mapped
+  const char *data = nullptr;
+
+  /// size of the file in bytes
+  std::size_t bytes = 0;
+
+  /// modification time of the file in nanoseconds
+  std::int64_t mtime = 0;
+
+  /// boolean stating if the file could be opened
+  bool valid = false;
+};
+
+/*!
+ * parses a decimal number
+ * @param text text starting with the number
+ * @param value parsed number
+ * @return boolean stating if all of text was a number
+ */
+bool parse_int(const std::string_view text, int &value) {
+  const auto [end, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  return std::errc{} == error && text.data() + text.size() == end;
+}
+
+/*!
+ * converts a local date to the time of its midnight, caching the last date
+ * since consecutive lines nearly always share it
+ * @param year year
+ * @param month month
+ * @param day day of the month
+ * @return seconds since the epoch
+ */
+std::int64_t local_midnight(const int year, const int month, const int day) {
+  thread_local int cached[3] = {-1, -1, -1};
+  thread_local std::int64_t midnight = 0;
+  if (year != cached[0] || month != cached[1] || day != cached[2]) {
+    std::tm tm{};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_isdst = -1;
+    midnight = std::mktime(&tm);
+    cached[0] = year;
+    cached[1] = month;
+    cached[2] = day;
+  }
+  return midnight;
+}
+
+/*!
+ * parses a time of day given as HH:MM[:SS[.ffffff]]
+ * @param text time of day
+ * @return microseconds since midnight, negative if malformed
+ */
+std::int64_t parse_clock(const std::string_view text) {
+  int hour = 0;
+  int minute = 0;
+  int second = 0;
+  int micros = 0;
+  if (text.size() < 5 || ':' != text[2] ||
+      !parse_int(text.substr(0, 2), hour) ||
+      !parse_int(text.substr(3, 2), minute)) {
+    return -1;
+  }
+  if (text.size() > 5) {
+    if (text.size() < 8 || ':' != text[5] ||
+        !parse_int(text.substr(6, 2), second)) {
+      return -1;
+    }
+    if (text.size() > 8) {
+      // the fraction is scaled to microseconds whatever its length
+      const auto fraction = text.substr(9, 6);
+      if ('.' != text[8] || !parse_int(fraction, micros)) {
+        return -1;
+      }
+      for (std::size_t i = fraction.size(); i < 6; ++i) {
+        micros *= 10;
+      }
+    }
+  }
+  return ((hour * 60LL + minute) * 60LL + second) * 1000000LL + micros;
+}
+
+/*!
+ * parses a local date and time given as YYYY-MM-DD HH:MM[:SS[.ffffff]]
+ * @param text date and time
+ * @return microseconds since the epoch, time_min if malformed
+ */
+std::int64_t parse_time(const std::string_view text) {
+  int year = 0;
+  int month = 0;
+  int day = 0;
+  if (text.size() < 16 || '-' != text[4] || '-' != text[7] ||
+      (' ' != text[10] && 'T' != text[10]) ||
+      !parse_int(text.substr(0, 4), year) ||
+      !parse_int(text.substr(5, 2), month) ||
+      !parse_int(text.substr(8, 2), day)) {
+    return time_min;
+  }
+  const std::int64_t clock = parse_clock(text.substr(11));
+  if (clock < 0) {
+    return time_min;
+  }
+  return local_midnight(year, month, day) * 1000000LL + clock;
+}
+
+/*!
+ * removes terminal escape sequences as written by MPIManager to the terminal
+ * @param line line
+ * @return line without escape sequences
+ */
+std::string strip_escapes(const std::string_view line) {
+  std::string plain;
+  plain.reserve(line.size());
+  for (std::size_t i = 0; i < line.size(); ++i) {
+    if ('\x1b' != line[i]) {
+      plain += line[i];
+      continue;
+    }
+    while (i < line.size() && 'm' != line[i]) {
+      ++i;
+    }
+  }
+  return plain;
+}
+
+/*!
+ * parses the prefix of a log line, lines of other programs keep the previous
+ * time and name no rank or level
+ * @param line line without its newline
+ * @param fields fields of the previous line, updated
+ */
+void parse_line(std::string_view line, Fields &fields) {
+  std::string plain;
+  if (std::string_view::npos != line.find('\x1b')) {
+    plain = strip_escapes(line);
+    line = plain;
+  }
+  fields.rank = -1;
+  fields.level = -1;
+
+  // file sinks prefix YYYY-MM-DD HH:MM:SS.ffffff
+  if (line.size() > 27 && '-' == line[4] && ' ' == line[26]) {
+    if (const auto time = parse_time(line.substr(0, 26)); time_min != time) {
+      fields.time = time;
+      line.remove_prefix(27);
+    }
+  }
+
+  if (!line.starts_with("Rank ")) {
+    return;
+  }
+  line.remove_prefix(5);
+  const auto colon = line.find(": [");
+  const auto close = line.find("]: ");
+  int rank = 0;
+  if (std::string_view::npos == colon || std::string_view::npos == close ||
+      close < colon || !parse_int(line.substr(0, colon), rank)) {
+    return;
+  }
+  const auto tag = line.substr(colon + 3, close - colon - 3);
+  for (int level = 0; level < 8; ++level) {
+    if (level_tags[level] == tag) {
+      fields.rank = rank;
+      fields.level = level;
+      return;
+    }
+  }
+}
+
+/*!
+ * splits a file into blocks of whole lines and summarizes them in parallel
+ * @param pool thread pool
+ * @param file mapped log file
+ * @param block_bytes nominal block size
+ * @return blocks
+ */
+std::vector<Block> build_index(ThreadPool &pool, const Mapping &file,
+                               const std::size_t block_bytes) {
+  std::vector<Block> blocks;
+  for (std::size_t offset = 0; offset < file.bytes;) {
+    std::size_t end = std::min(offset + block_bytes, file.bytes);
+    if (end < file.bytes) {
+      const void *newline =
+          std::memchr(file.data + end, '\n', file.bytes - end);
+      end = nullptr == newline
+                ? file.bytes
+                : static_cast<const char *>(newline) - file.data + 1;
+    }
+    blocks.push_back({.offset = offset, .bytes = end - offset});
+    offset = end;
+  }
+
+  pool.parallel_for(
+      0, blocks.size(),
+      [&](const std::size_t i) {
+        Block &block = blocks[i];
+        std::string_view text(file.data + block.offset, block.bytes);
+        Fields fields;
+        while (!text.empty()) {
+          const auto newline = text.find('\n');
+          const auto line = text.substr(0, newline);
+          text.remove_prefix(std::string_view::npos == newline ? text.size()
+                                                               : newline + 1);
+          parse_line(line, fields);
+          ++block.lines;
+          if (time_min != fields.time) {
+            block.first = std::min(block.first, fields.time);
+            block.last = std::max(block.last, fields.time);
+          }
+          if (fields.level >= 0) {
+            block.rank_lo = std::min(block.rank_lo, fields.rank);
+            block.rank_hi = std::max(block.rank_hi, fields.rank);
+            block.levels |= 1u << fields.level;
+          }
+        }
+        // a block without timestamps matches every time range
+        if (block.first > block.last) {
+          block.first = time_min;
+          block.last = time_max;
+        }
+      },
+      Schedule::dynamic, 1);
+  return blocks;
+}
+
+/*!
+ * loads the index of a file if it is current, otherwise builds it
+ * @param pool thread pool
+ * @param path log file path
+ * @param file mapped log file
+ * @param block_bytes nominal block size used when building
+ * @return blocks
+ */
+std::vector<Block> load_index(ThreadPool &pool, const std::string &path,
+                              const Mapping &file,
+                              const std::size_t block_bytes) {
+  const Mapping index(path + ".idx");
+  IndexHeader header{};
+  if (nullptr != index.data && index.bytes >= sizeof header) {
+    std::memcpy(&header, index.data, sizeof header);
+    if (0 == std::memcmp(header.magic, index_magic, sizeof index_magic) &&
+        file.bytes == header.file_bytes && file.mtime == header.file_mtime &&
+        index.bytes == sizeof header + header.blocks * sizeof(Block)) {
+      std::vector<Block> blocks(header.blocks);
+      std::memcpy(blocks.data(), index.data + sizeof header,
+                  blocks.size() * sizeof(Block));
+      return blocks;
+    }
+  }
+  return build_index(pool, file, block_bytes);
+}
+
+/*!
+ * checks if a line passes the filter
+ * @param query filter
+ * @param fields fields of the line
+ * @return boolean stating if the line matches
+ */
+bool matches(const Query &query, const Fields &fields) {
+  if (fields.level < 0 || 0 == (query.levels & 1u << fields.level)) {
+    return false;
+  }
+  if (fields.time < query.from || fields.time >= query.to) {
+    return false;
+  }
+  if (query.ranks.empty()) {
+    return true;
+  }
+  for (const auto &[lo, hi] : query.ranks) {
+    if (fields.rank >= lo && fields.rank <= hi) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * checks if a block may hold lines passing the filter
+ * @param query filter
+ * @param block block summary
+ * @return boolean stating if the block must be read
+ */
+bool overlaps(const Query &query, const Block &block) {
+  if (0 == (query.levels & block.levels) || block.last < query.from ||
+      block.first >= query.to) {
+    return false;
+  }
+  if (query.ranks.empty()) {
+    return true;
+  }
+  for (const auto &[lo, hi] : query.ranks) {
+    if (block.rank_lo <= hi && block.rank_hi >= lo) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/*!
+ * writes the index of every file next to it
+ * @param pool thread pool
+ * @param paths log files
+ * @param block_bytes nominal block size
+ * @return exit status
+ */
+int index_files(ThreadPool &pool, const std::vector<std::string> &paths,
+                const std::size_t block_bytes) {
+  for (const auto &path : paths) {
+    const Mapping file(path);
+    if (!file.valid) {
+      fmt::print(stderr, "mpimgr-logq: cannot read `{}`\n", path);
+      return EXIT_FAILURE;
+    }
+    const auto blocks = build_index(pool, file, block_bytes);
+    IndexHeader header{};
+    std::memcpy(header.magic, index_magic, sizeof index_magic);
+    header.file_bytes = file.bytes;
+    header.file_mtime = file.mtime;
+    header.blocks = blocks.size();
+    std::ofstream out(path + ".idx", std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char *>(&header), sizeof header);
+    out.write(reinterpret_cast<const char *>(blocks.data()),
+              static_cast<std::streamsize>(blocks.size() * sizeof(Block)));
+    if (!out) {
+      fmt::print(stderr, "mpimgr-logq: cannot write `{}.idx`\n", path);
+      return EXIT_FAILURE;
+    }
+    fmt::print(stderr, "mpimgr-logq: indexed `{}`, {} bytes in {} blocks\n",
+               path, file.bytes, blocks.size());
+  }
+  return EXIT_SUCCESS;
+}
+
+/*!
+ * prints the lines of every file passing the filter, reading only blocks
+ * whose summary overlaps it
+ * @param pool thread pool
+ * @param paths log files
+ * @param query filter
+ * @param block_bytes nominal block size used for missing indices
+ * @return exit status
+ */
+int query_files(ThreadPool &pool, const std::vector<std::string> &paths,
+                Query query, const std::size_t block_bytes) {
+  std::size_t matched = 0;
+  std::size_t read = 0;
+  std::size_t total = 0;
+  for (const auto &path : paths) {
+    const Mapping file(path);
+    if (!file.valid) {
+      fmt::print(stderr, "mpimgr-logq: cannot read `{}`\n", path);
+      return EXIT_FAILURE;
+    }
+    const auto blocks = load_index(pool, path, file, block_bytes);
+
+    // times given without a date refer to the day of the first timestamp
+    std::int64_t first = time_max;
+    for (const auto &block : blocks) {
+      if (time_min != block.first) {
+        first = std::min(first, block.first);
+      }
+    }
+    if (time_max != first) {
+      const std::time_t seconds = first / 1000000;
+      std::tm tm{};
+      localtime_r(&seconds, &tm);
+      const std::int64_t midnight =
+          local_midnight(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) *
+          1000000LL;
+      if (query.from_clock >= 0) {
+        query.from = midnight + query.from_clock;
+      }
+      if (query.to_clock >= 0) {
+        query.to = midnight + query.to_clock;
+      }
+    }
+
+    std::vector<std::size_t> selected;
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+      if (overlaps(query, blocks[i])) {
+        selected.push_back(i);
+      }
+    }
+    total += blocks.size();
+    read += selected.size();
+
+    std::vector<std::string> outputs(selected.size());
+    std::vector<std::size_t> counts(selected.size());
+    pool.parallel_for(
+        0, selected.size(),
+        [&](const std::size_t i) {
+          const Block &block = blocks[selected[i]];
+          std::string_view text(file.data + block.offset, block.bytes);
+          Fields fields;
+          while (!text.empty()) {
+            const auto newline = text.find('\n');
+            const auto line = text.substr(0, newline);
+            text.remove_prefix(std::string_view::npos == newline
+                                   ? text.size()
+                                   : newline + 1);
+            parse_line(line, fields);
+            if (matches(query, fields)) {
+              outputs[i].append(line);
+              outputs[i] += '\n';
+              ++counts[i];
+            }
+          }
+        },
+        Schedule::dynamic, 1);
+    for (std::size_t i = 0; i < selected.size(); ++i) {
+      std::fwrite(outputs[i].data(), 1, outputs[i].size(), stdout);
+      matched += counts[i];
+    }
+  }
+  fmt::print(stderr, "mpimgr-logq: {} lines matched, {} of {} blocks read\n",
+             matched, read, total);
+  return EXIT_SUCCESS;
+}
+
+/*!
+ * prints the usage
+ * @return exit status
+ */
+int usage() {
+  fmt::print(
+      stderr,
+      "usage: mpimgr-logq index [options] FILE...\n"
+      "       mpimgr-logq query [options] [filters] FILE...\n"
+      "options:\n"
+      "  -j N               threads including the main thread, 1 runs "
+      "single-threaded, default: one per CPU\n"
+      "  -b BYTES           nominal block size, default: 1048576\n"
+      "filters:\n"
+      "  --level LEVEL      LEVEL and more severe levels\n"
+      "  --levels L1,L2,..  exactly these levels\n"
+      "  --ranks R1-R2,R3   ranks, ranges are inclusive\n"
+      "  --from TIME        earliest time, inclusive\n"
+      "  --to TIME          latest time, exclusive\n"
+      "TIME is YYYY-MM-DD HH:MM[:SS] or HH:MM[:SS] on the day of the first "
+      "timestamp of each file\n");
+  return EXIT_FAILURE;
+}
+
+/*!
+ * parses a level tag in any case
+ * @param text level tag
+ * @return level enum value, negative if unknown
+ */
+int parse_level(const std::string_view text) {
+  std::string tag(text);
+  for (auto &c : tag) {
+    c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+  }
+  for (int level = 0; level < 8; ++level) {
+    if (level_tags[level] == tag) {
+      return level;
+    }
+  }
+  return -1;
+}
+
+/*!
+ * parses a time bound given with or without a date
+ * @param text time
+ * @param time parsed time if a date was given
+ * @param clock parsed time of day if no date was given
+ * @return boolean stating if the time is well formed
+ */
+bool parse_bound(const std::string_view text, std::int64_t &time,
+                 std::int64_t &clock) {
+  if (text.size() <= 12 && std::string_view::npos == text.find('-')) {
+    clock = parse_clock(text);
+    return clock >= 0;
+  }
+  time = parse_time(text);
+  return time_min != time;
+}
+} // namespace
+
+/*!
+ * builds block indices over MPIManager log files and queries them by level,
+ * rank and time, reading only the blocks whose summary overlaps the query
+ */
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    return usage();
+  }
+  const std::string_view command = argv[1];
+  std::size_t threads = 0;
+  std::size_t block_bytes = 1 << 20;
+  Query query;
+  std::vector<std::string> paths;
+
+  for (int i = 2; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if ("-j" == arg && has_value) {
+      threads = std::strtoull(argv[++i], nullptr, 10);
+    } else if ("-b" == arg && has_value) {
+      block_bytes = std::max<std::size_t>(
+          std::strtoull(argv[++i], nullptr, 10), 4096);
+    } else if ("--level" == arg && has_value) {
+      const int level = parse_level(argv[++i]);
+      if (level < 0) {
+        return usage();
+      }
+      query.levels = (2u << level) - 1;
+    } else if ("--levels" == arg && has_value) {
+      query.levels = 0;
+      std::string_view list = argv[++i];
+      while (!list.empty()) {
+        const auto comma = std::min(list.find(','), list.size());
+        const int level = parse_level(list.substr(0, comma));
+        if (level < 0) {
+          return usage();
+        }
+        query.levels |= 1u << level;
+        list.remove_prefix(std::min(comma + 1, list.size()));
+      }
+    } else if ("--ranks" == arg && has_value) {
+      std::string_view list = argv[++i];
+      while (!list.empty()) {
+        const auto comma = std::min(list.find(','), list.size());
+        const auto range = list.substr(0, comma);
+        const auto dash = std::min(range.find('-'), range.size());
+        int lo = 0;
+        int hi = 0;
+        if (!parse_int(range.substr(0, dash), lo) ||
+            !parse_int(dash < range.size() ? range.substr(dash + 1)
+                                           : range.substr(0, dash),
+                       hi)) {
+          return usage();
+        }
+        query.ranks.emplace_back(lo, hi);
+        list.remove_prefix(std::min(comma + 1, list.size()));
+      }
+    } else if ("--from" == arg && has_value) {
+      if (!parse_bound(argv[++i], query.from, query.from_clock)) {
+        return usage();
+      }
+    } else if ("--to" == arg && has_value) {
+      if (!parse_bound(argv[++i], query.to, query.to_clock)) {
+        return usage();
+      }
+    } else if (arg.starts_with("-")) {
+      return usage();
+    } else {
+      paths.emplace_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    return usage();
+  }
+
+  // the calling thread takes part in parallel_for, so one fewer worker
+  ThreadPool pool(0 == threads ? std::nullopt
+                               : std::optional<std::size_t>(threads - 1));
+  if ("index" == command) {
+    return index_files(pool, paths, block_bytes);
+  }
+  if ("query" == command) {
+    return query_files(pool, paths, query, block_bytes);
+  }
+  return usage();
+}